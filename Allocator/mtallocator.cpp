@@ -1,12 +1,17 @@
 #include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <vector>
 #include <cassert>
 
 
 const size_t HEAPS_COUNT = std::thread::hardware_concurrency() * 2;
 const size_t SUPERBLOCK_SIZE = 8192; //удвоенный размер страницы памяти - почему бы и нет
+const size_t CACHE_LINE_SIZE = 64; // корзины с разными мьютексами не должны делить кэш-линию
 const size_t GRAND_HEAP_ID = HEAPS_COUNT + 1; //идентификатор глобальной кучи
 thread_local const size_t THREAD_ID = std::hash<std::thread::id>()(std::this_thread::get_id()) % HEAPS_COUNT;
 
@@ -28,6 +33,7 @@ public:
     SuperBlock() {}
     SuperBlock(size_t sizeOfBlock_) :
             heapNumber(0),
+            nextInStack(nullptr),
             sizeOfBlock(sizeOfBlock_),
             sizeOfUsed(0),
             beginsOfBlocks(SUPERBLOCK_SIZE / sizeOfBlock_)
@@ -50,7 +56,10 @@ public:
     void* allocBlock();
     void deallocBlock(void* blockPtr);
 
-    size_t heapNumber; //номер кучи, в которой лежит блок
+    std::atomic<size_t> heapNumber; //номер кучи, в которой лежит блок. Меняется только под мьютексом
+                                    //корзины-владельца, а для глобальной кучи - под ownerMutex
+    std::mutex ownerMutex; // защищает суперблок, пока он лежит в глобальной куче
+    std::atomic<SuperBlock*> nextInStack; // следующий суперблок в стеке глобальной кучи
 
     friend class Allocator;
 private:
@@ -108,8 +117,10 @@ void SuperBlock::deallocBlock(void* blockPtr)
 
 /*
  * Класс - корзина. В корзине лежат суперблоки, разбитые на одинаковые блоки
+ * У каждой корзины свой мьютекс и свой учёт памяти, так что потоки, выделяющие блоки
+ * разных размеров в одной куче, друг друга не ждут. Корзина занимает целые кэш-линии
  */
-class Basket
+class alignas(CACHE_LINE_SIZE) Basket
 {
 public:
     Basket() :
@@ -139,6 +150,14 @@ public:
     SuperBlock* getSuperBlock(); // получить произвольный не занятый суперблок
     std::pair<SuperBlock*, void*> getBlock(); // получить какой-то свободный блок
 
+    void takeSuperBlock(SuperBlock* superBlock); // учесть суперблок, пришедший в корзину
+    SuperBlock* releaseSuperBlock(); // вынуть не занятый суперблок вместе с его памятью из учёта
+    void addUsedMemory(size_t bytes);
+    void removeUsedMemory(size_t bytes);
+    bool hasExcessMemory(); // пустует ли корзина настолько, что суперблок стоит отдать
+
+    std::mutex basketMutex; // защищает корзину и все её суперблоки
+
     friend class Allocator;
 private:
     std::vector<SuperBlock*> occupiedSuperBlocks; // полностью занятые суперблоки
@@ -216,6 +235,45 @@ std::pair<SuperBlock*, void*> Basket::getBlock()
     return {superBlock, block};
 };
 
+/*
+ * Суперблок (новый или из глобальной кучи) переходит в корзину вместе с занятой в нём памятью
+ */
+void Basket::takeSuperBlock(SuperBlock* superBlock)
+{
+    sizeOfAllocated += SUPERBLOCK_SIZE;
+    sizeOfUsed += superBlock->getUsedMemory();
+}
+
+SuperBlock* Basket::releaseSuperBlock()
+{
+    SuperBlock* superBlock = getSuperBlock();
+    if (superBlock != nullptr) {
+        sizeOfAllocated -= SUPERBLOCK_SIZE;
+        sizeOfUsed -= superBlock->getUsedMemory();
+    }
+    return superBlock;
+}
+
+void Basket::addUsedMemory(size_t bytes)
+{
+    sizeOfUsed += bytes;
+}
+
+void Basket::removeUsedMemory(size_t bytes)
+{
+    sizeOfUsed -= bytes;
+}
+
+/*
+ * Суперблок отдаём, когда свободно больше четырёх суперблоков и больше четверти
+ * всей памяти корзины. Сравниваем без вычитания, чтобы не уйти в переполнение size_t
+ */
+bool Basket::hasExcessMemory()
+{
+    return (sizeOfUsed + 4 * SUPERBLOCK_SIZE < sizeOfAllocated) &&
+            (sizeOfUsed * 4 < 3 * sizeOfAllocated);
+}
+
 
 //--------------------Heap Definition----------------------------
 
@@ -223,28 +281,44 @@ class Heap
 {
 public:
     Heap() :
-            sizeOfLargestBasket(minBasketSize)
+            sizeOfLargestBasket(minBasketSize),
+            basketsCount(0)
     {
         while (sizeOfLargestBasket <= SUPERBLOCK_SIZE / 2) { // блоки большего размера будут храниться в глобальной куче
-            baskets.push_back(Basket()); // в куче лежат корзины разных размеров(по степеням двойки)
+            ++basketsCount; // в куче лежат корзины разных размеров(по степеням двойки)
             sizeOfLargestBasket *= 2; // в данном случае, степени двойки
         }
+        /*
+         * vector до C++17 не выравнивает элементы по alignas, поэтому выравниваем память
+         * под корзины сами: берём с запасом в кэш-линию и сдвигаем начало
+         */
+        basketsMemory = malloc(basketsCount * sizeof(Basket) + CACHE_LINE_SIZE);
+        uintptr_t address = reinterpret_cast<uintptr_t>(basketsMemory);
+        address = (address + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+        baskets = reinterpret_cast<Basket*>(address);
+        for (size_t i = 0;i < basketsCount;++i) {
+            new (baskets + i) Basket();
+        }
     }
     ~Heap()
     {
-
+        for (size_t i = 0;i < basketsCount;++i) {
+            baskets[i].~Basket();
+        }
+        free(basketsMemory);
     }
 
     size_t getSuitableBasketSize(size_t memSize); // "округлить" размер memSize до размера блока
     size_t getBasketNumber(size_t basketSize); // получить номер корзины, подходящей под данный basketSize
     Basket* getBasket (size_t memSize); // получить корзину, подходящую
-
-    std::mutex heapMutex;
+    size_t getBasketsCount(); // количество корзин (размерных классов)
 private:
     size_t minBasketSize = 16; // размер минимальных блоков в куче
     size_t sizeOfLargestBasket; //наибольший размер
 
-    std::vector<Basket> baskets; // вектор корзин
+    void* basketsMemory; // память под корзины с запасом на выравнивание
+    Basket* baskets; // массив корзин, выровненный по кэш-линии
+    size_t basketsCount;
 };
 
 
@@ -283,10 +357,128 @@ size_t Heap::getBasketNumber(size_t basketSize)
 
 /*
  * Получаем указатель на корзину нужного размера
+ * Корзины лежат в выровненной вручную памяти, так что выход за их число испортил бы
+ * соседние данные молча - блоки больше наибольшей корзины должны уходить в malloc
  */
 Basket* Heap::getBasket(size_t memSize)
 {
-    return &(baskets[getBasketNumber(memSize)]);
+    size_t basketNumber = getBasketNumber(memSize);
+    assert(basketNumber < basketsCount);
+    return &(baskets[basketNumber]);
+}
+
+size_t Heap::getBasketsCount()
+{
+    return basketsCount;
+}
+
+//--------------------SuperBlockStack Definition----------------------
+
+/*
+ * Стек Трайбера из суперблоков. Вершина хранится одним 64-битным словом:
+ * в младших 48 битах указатель, в старших 16 - счётчик изменений (тег), чтобы
+ * CAS не перепутал снятый и снова положенный суперблок (проблема ABA).
+ * Суперблоки не удаляются до конца работы аллокатора, так что читать nextInStack
+ * у уже снятой кем-то вершины безопасно - такой CAS просто не пройдёт по тегу
+ */
+class SuperBlockStack
+{
+public:
+    SuperBlockStack() :
+        head(0)
+    {}
+
+    void push(SuperBlock* superBlock);
+    SuperBlock* pop(); // nullptr, если стек пуст
+private:
+    static const int TAG_SHIFT = 48;
+    static const uint64_t POINTER_MASK = (uint64_t(1) << TAG_SHIFT) - 1;
+
+    static SuperBlock* getPointer(uint64_t word);
+    static uint64_t makeWord(SuperBlock* superBlock, uint64_t oldWord); // новая вершина со следующим тегом
+
+    std::atomic<uint64_t> head;
+};
+
+//--------------------SuperBlockStack Implementation------------------
+
+SuperBlock* SuperBlockStack::getPointer(uint64_t word)
+{
+    return reinterpret_cast<SuperBlock*>(static_cast<uintptr_t>(word & POINTER_MASK));
+}
+
+uint64_t SuperBlockStack::makeWord(SuperBlock* superBlock, uint64_t oldWord)
+{
+    uint64_t pointer = reinterpret_cast<uintptr_t>(superBlock);
+    assert((pointer & ~POINTER_MASK) == 0); // пользовательские адреса укладываются в 48 бит
+    return (((oldWord >> TAG_SHIFT) + 1) << TAG_SHIFT) | pointer;
+}
+
+void SuperBlockStack::push(SuperBlock* superBlock)
+{
+    uint64_t oldHead = head.load(std::memory_order_relaxed);
+    do {
+        superBlock->nextInStack.store(getPointer(oldHead), std::memory_order_relaxed);
+    } while (!head.compare_exchange_weak(oldHead, makeWord(superBlock, oldHead),
+                                         std::memory_order_release, std::memory_order_relaxed));
+}
+
+SuperBlock* SuperBlockStack::pop()
+{
+    uint64_t oldHead = head.load(std::memory_order_acquire);
+    for (;;) {
+        SuperBlock* top = getPointer(oldHead);
+        if (top == nullptr) {
+            return nullptr;
+        }
+        SuperBlock* next = top->nextInStack.load(std::memory_order_relaxed);
+        if (head.compare_exchange_weak(oldHead, makeWord(next, oldHead),
+                                       std::memory_order_acquire, std::memory_order_acquire)) {
+            return top;
+        }
+    }
+}
+
+//--------------------GrandHeap Definition----------------------------
+
+/*
+ * Глобальная куча: по стеку суперблоков на каждый размер блока, без общей блокировки.
+ * В стеках лежат только не полностью занятые суперблоки: выделять из них можно,
+ * лишь сняв суперблок в локальную кучу, а освобождения только добавляют места
+ */
+class GrandHeap
+{
+public:
+    GrandHeap(size_t basketsCount) :
+        stacks(basketsCount)
+    {}
+    ~GrandHeap()
+    {
+        for (size_t i = 0;i < stacks.size();++i) {
+            while (SuperBlock* superBlock = stacks[i].pop()) {
+                delete superBlock;
+            }
+        }
+    }
+
+    void putSuperBlock(size_t basketNumber, SuperBlock* superBlock); // отдать суперблок в глобальную кучу
+    SuperBlock* getSuperBlock(size_t basketNumber); // забрать произвольный суперблок, nullptr если нет
+private:
+    std::vector<SuperBlockStack> stacks; // стеки по номерам корзин
+};
+
+//--------------------GrandHeap Implementation------------------------
+
+void GrandHeap::putSuperBlock(size_t basketNumber, SuperBlock* superBlock)
+{
+    assert(basketNumber < stacks.size());
+    stacks[basketNumber].push(superBlock);
+}
+
+SuperBlock* GrandHeap::getSuperBlock(size_t basketNumber)
+{
+    assert(basketNumber < stacks.size());
+    return stacks[basketNumber].pop();
 }
 
 //--------------------Allocator Definition----------------------------
@@ -297,10 +489,10 @@ public:
     Allocator()
     {
         offset = sizeof(WrapOnSuperBlockPointer);
-        grandHeap = new Heap();
         for (size_t i = 0;i < HEAPS_COUNT;++i) {
             heaps.push_back(new Heap());
         }
+        grandHeap = new GrandHeap(heaps[0]->getBasketsCount());
     }
     ~Allocator()
     {
@@ -314,7 +506,7 @@ public:
     void* allocate(size_t bytes);
     void deallocate(void* ptr);
 private:
-    Heap* grandHeap; // "глобальная" куча
+    GrandHeap* grandHeap; // "глобальная" куча
     std::vector<Heap*> heaps; // все остальный кучи.
     size_t offset; // размер сдвига SuperBlock, для того, чтобы перед ним поместить указатель на кучу
 };
@@ -324,7 +516,8 @@ private:
 void* Allocator::allocate(size_t bytes)
 {
     //если размер блока слишком велик, то целесообразно выделять его в глобальной куче
-    if (bytes >= SUPERBLOCK_SIZE / 2) {
+    //учитываем и заголовок: в наибольшую корзину влезает ровно SUPERBLOCK_SIZE / 2 вместе с ним
+    if (bytes + offset > SUPERBLOCK_SIZE / 2) {
         void* ptr = malloc(bytes + offset);
         if (ptr == nullptr) {
             return nullptr;
@@ -339,32 +532,29 @@ void* Allocator::allocate(size_t bytes)
     void* resultPtr = nullptr; // ответ
     size_t heapNumber = THREAD_ID;// определили кучу для текущего потока
     Heap* heap = heaps[heapNumber];
-    std::unique_lock<std::mutex> heapLock(heap->heapMutex);//заблокировали её
     Basket* basket = heap->getBasket(bytes + offset);//выбрали подходящий basket, чтобы всё влезло
+    std::unique_lock<std::mutex> basketLock(basket->basketMutex);//заблокировали только его
     std::pair<SuperBlock*, void*> block = basket->getBlock();//получили блок
     resultPtr = block.second;
     SuperBlock* currentSuperBlock = block.first; // здесь и будет записан ответ
     if (currentSuperBlock == nullptr) { // nullptr - значит, нет свободного суперблока в данной корзине
-        std::unique_lock<std::mutex> grandHeapLock(grandHeap->heapMutex); // блокируем кучу
-        Basket* grandHeapBasket = grandHeap->getBasket(bytes + offset); //находим подходящую корзину в глобальной куче
-        std::pair<SuperBlock*, void*> grandHeapBlock = grandHeapBasket->getBlock(); // взяли блок из глобальной кучи
-        SuperBlock* grandHeapSuperBlock = grandHeapBlock.first;
+        SuperBlock* grandHeapSuperBlock = grandHeap->getSuperBlock(heap->getBasketNumber(bytes + offset));
+                                                // сняли суперблок со стека глобальной кучи
         if (grandHeapSuperBlock == nullptr) { // если и тут нет свободного суперблока, то
                                                 // добавляем новый суперблок в текущую кучу
             currentSuperBlock = new SuperBlock(heap->getSuitableBasketSize(bytes + offset));
             currentSuperBlock->heapNumber = heapNumber;
             resultPtr = currentSuperBlock->allocBlock();
-            basket->sizeOfAllocated += SUPERBLOCK_SIZE;
+            basket->takeSuperBlock(currentSuperBlock);
         } else {
-            resultPtr = grandHeapBlock.second; // если же нашёлся свободный суперблок, то
-            currentSuperBlock = grandHeapSuperBlock; // добавляем суперблок в глобальную кучу
-            currentSuperBlock->heapNumber = heapNumber;
-
-            grandHeapBasket->sizeOfAllocated -= SUPERBLOCK_SIZE; // поправляем информацию о выделенной и
-            basket->sizeOfAllocated += SUPERBLOCK_SIZE; // используемой памяти
-            grandHeapBasket->sizeOfUsed -= currentSuperBlock->getUsedMemory();
-            basket->sizeOfUsed += currentSuperBlock->getUsedMemory();
-        }
+            currentSuperBlock = grandHeapSuperBlock; // если же нашёлся свободный суперблок, то
+            {                                        // забираем его в текущую кучу. Освобождения в нём
+                std::lock_guard<std::mutex> ownerLock(currentSuperBlock->ownerMutex); // могли идти прямо сейчас
+                currentSuperBlock->heapNumber = heapNumber;
+            }
+            resultPtr = currentSuperBlock->allocBlock();
+            basket->takeSuperBlock(currentSuperBlock); // поправляем информацию о выделенной и
+        }                                             // используемой памяти
     }
 
     char* bytesPtr = reinterpret_cast<char*>(resultPtr);
@@ -374,7 +564,7 @@ void* Allocator::allocate(size_t bytes)
                                                     //записываем указатель на суперблок перед выделяемой памятью
     wrapOnSuperBlockPointer->superBlockPointer = currentSuperBlock;
     currentSuperBlock->sizeOfUsed += currentSuperBlock->getSizeOfBlock();
-    basket->sizeOfUsed += currentSuperBlock->getSizeOfBlock(); // пересчитываем память
+    basket->addUsedMemory(currentSuperBlock->getSizeOfBlock()); // пересчитываем память
     basket->addSuperBlock(currentSuperBlock);//добавляем суперблок в корзину
     resultPtr = bytesPtr + offset;//возвращаем результат
     return resultPtr;
@@ -395,50 +585,41 @@ void Allocator::deallocate(void *ptr)
         free(bytesPtr);
         return;
     }
-    size_t heapNumber = GRAND_HEAP_ID; //ищем кучу
-    Heap* heap = grandHeap;
-    size_t count = 0; // нужно, чтобы хотя бы раз цикл выполнился
-    while (count == 0 || heapNumber != superBlock->heapNumber) { // пока не найдём
-        if (count > 0) {
-            if (heapNumber == GRAND_HEAP_ID) {
-                grandHeap->heapMutex.unlock();
-            } else {
-                heaps[heapNumber]->heapMutex.unlock();
-            }
-        }
+    size_t heapNumber; //ищем кучу
+    Basket* basket = nullptr;
+    std::mutex* ownerMutex;
+    while (true) { // суперблок может переехать, пока мы ждём блокировку - тогда пробуем снова
         heapNumber = superBlock->heapNumber;
-        if (heapNumber == GRAND_HEAP_ID) { // находим кучу, в которой лежит суперблок
-            grandHeap->heapMutex.lock();
-            heap = grandHeap;
+        if (heapNumber == GRAND_HEAP_ID) { // в глобальной куче суперблок защищён своим мьютексом
+            ownerMutex = &(superBlock->ownerMutex);
         } else {
-            heaps[heapNumber]->heapMutex.lock();
-            heap = heaps[heapNumber];
+            basket = heaps[heapNumber]->getBasket(superBlock->getSizeOfBlock()); // иначе - мьютексом корзины
+            ownerMutex = &(basket->basketMutex);
+        }
+        ownerMutex->lock();
+        if (heapNumber == superBlock->heapNumber) {
+            break;
         }
-        ++count;
+        ownerMutex->unlock();
     }
-    Basket* basket = heap->getBasket(superBlock->getSizeOfBlock());//нашли кучу, откуда деаллоцировать
     superBlock->sizeOfUsed -= superBlock->getSizeOfBlock();
-    basket->sizeOfUsed -= superBlock->getSizeOfBlock();
-    basket->deallocSuperBlock(superBlock, bytesPtr); // деаллоцировали память
     if (heapNumber == GRAND_HEAP_ID) {
-        grandHeap->heapMutex.unlock(); //если глобальная куча, то деаллоцировали
+        superBlock->deallocBlock(bytesPtr); // суперблок лежит в стеке глобальной кучи, а там
+        ownerMutex->unlock();                // заполненных не бывает - списки двигать не нужно
         return;
     }
-    if ((basket->sizeOfUsed < basket->sizeOfAllocated - 4 * SUPERBLOCK_SIZE) && // если же нет
-            (basket->sizeOfUsed * 4 < 3 * basket->sizeOfAllocated)) { // проверяем, не выгодно ли нам  перенести
-        //std::unique_lock<std::mutex> grandBasketLock(grandHeap->heapMutex); // блок в глобальную кучу. Если выгодно, то
-        Basket* grandBasket = grandHeap->getBasket(superBlock->getSizeOfBlock()); // переносим
-        SuperBlock* currentSuperBlock = basket->getSuperBlock();
-        currentSuperBlock->heapNumber = GRAND_HEAP_ID;
-
-        grandBasket->sizeOfUsed += currentSuperBlock->getUsedMemory();// аккуратно пересчитываем память
-        basket->sizeOfUsed -= currentSuperBlock->getUsedMemory();
-        grandBasket->sizeOfAllocated += SUPERBLOCK_SIZE;
-        basket->sizeOfAllocated -= SUPERBLOCK_SIZE;
-
-        grandBasket->addSuperBlock(currentSuperBlock); // разблокируем
+    basket->removeUsedMemory(superBlock->getSizeOfBlock());
+    basket->deallocSuperBlock(superBlock, bytesPtr); // деаллоцировали память
+    if (basket->hasExcessMemory()) { // проверяем, не выгодно ли нам перенести блок в глобальную кучу.
+        SuperBlock* currentSuperBlock = basket->releaseSuperBlock(); // Если выгодно, то переносим
+        {
+            std::lock_guard<std::mutex> ownerLock(currentSuperBlock->ownerMutex);
+            currentSuperBlock->heapNumber = GRAND_HEAP_ID;
+        }
+        grandHeap->putSuperBlock(heaps[heapNumber]->getBasketNumber(superBlock->getSizeOfBlock()),
+                                 currentSuperBlock);
     }
-    heap->heapMutex.unlock();
+    ownerMutex->unlock();
 }
 
 
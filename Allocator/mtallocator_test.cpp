@@ -0,0 +1,63 @@
+/*
+ * Регрессионный тест аллокатора: несколько потоков выделяют и освобождают блоки
+ * размеров у границы между корзинами и malloc (вместе с заголовком больше половины суперблока)
+ * Сборка и запуск:
+ *   g++ -std=c++11 -O2 -pthread mtallocator.cpp mtallocator_test.cpp -o mtallocator_test && ./mtallocator_test
+ */
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+
+extern void* mtalloc(size_t bytes);
+extern void mtfree(void* ptr);
+
+const size_t THREADS_COUNT = 8;
+const size_t ROUNDS_COUNT = 2000;
+const size_t MIN_SIZE = 4080;
+const size_t MAX_SIZE = 4095;
+
+/*
+ * Каждый блок заполняем своим байтом и перед освобождением проверяем, что его никто не испортил
+ */
+void allocateBorderSizes(size_t threadNumber, bool* isCorrupted)
+{
+    std::vector<char*> blocks;
+    for (size_t round = 0;round < ROUNDS_COUNT;++round) {
+        for (size_t size = MIN_SIZE;size <= MAX_SIZE;++size) {
+            char* block = reinterpret_cast<char*>(mtalloc(size));
+            memset(block, static_cast<int>(size + threadNumber) & 0xff, size);
+            blocks.push_back(block);
+        }
+        for (size_t i = 0;i < blocks.size();++i) {
+            size_t size = MIN_SIZE + i;
+            char expected = static_cast<char>((size + threadNumber) & 0xff);
+            if (blocks[i][0] != expected || blocks[i][size - 1] != expected) {
+                *isCorrupted = true;
+            }
+            mtfree(blocks[i]);
+        }
+        blocks.clear();
+    }
+}
+
+int main()
+{
+    std::vector<std::thread> threads;
+    bool isCorrupted[THREADS_COUNT] = {};
+    for (size_t i = 0;i < THREADS_COUNT;++i) {
+        threads.push_back(std::thread(allocateBorderSizes, i, &isCorrupted[i]));
+    }
+    for (size_t i = 0;i < THREADS_COUNT;++i) {
+        threads[i].join();
+    }
+    for (size_t i = 0;i < THREADS_COUNT;++i) {
+        if (isCorrupted[i]) {
+            printf("FAILED: memory of thread %zu was corrupted\n", i);
+            return 1;
+        }
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,233 @@
+#include <thread>
+#include <vector>
+#include "Batch.h"
+#include "GameRecord.h"
+
+
+namespace reversi
+{
+    namespace
+    {
+        Bitboard readBitboard(const std::string& record, size_t offset) {
+            Bitboard b = 0;
+            for (int x = 7; x >= 0; --x) {
+                b = (b << 8) | (unsigned char)record[offset + x];
+            }
+            return b;
+        }
+    }
+
+    BatchAnalyzer::BatchAnalyzer(const PatternEvaluator* patterns_) :
+        patterns(patterns_),
+        probCut(nullptr),
+        isReductionEnabled(false),
+        telemetry(nullptr),
+        threads(1),
+        depth(MAX_DEPTH - 1),
+        nodeLimit(0),
+        endgameEmpties(ENDGAME_EMPTIES),
+        window(1024),
+        isBinary(false),
+        nextOutput(0),
+        inputFinished(false),
+        output(nullptr)
+    {
+    }
+
+    void BatchAnalyzer::setThreads(int threads_)
+    {
+        threads = threads_ > 0 ? threads_ : 1;
+    }
+
+    /*
+    Глубина перебора, 0 - без ограничения (тогда нужен лимит узлов)
+    */
+    void BatchAnalyzer::setDepth(int depth_)
+    {
+        depth = depth_;
+    }
+
+    void BatchAnalyzer::setNodeLimit(long long nodeLimit_)
+    {
+        nodeLimit = nodeLimit_;
+    }
+
+    void BatchAnalyzer::setEndgameEmpties(int endgameEmpties_)
+    {
+        endgameEmpties = endgameEmpties_;
+    }
+
+    /*
+    Сколько позиций может быть прочитано, но ещё не выведено
+    */
+    void BatchAnalyzer::setWindow(size_t window_)
+    {
+        window = window_ > 0 ? window_ : 1;
+    }
+
+    void BatchAnalyzer::setProbCut(const ProbCut* probCut_)
+    {
+        probCut = probCut_;
+    }
+
+    void BatchAnalyzer::setLateMoveReductions(bool isEnabled)
+    {
+        isReductionEnabled = isEnabled;
+    }
+
+    void BatchAnalyzer::setTelemetry(TelemetryLog* telemetry_)
+    {
+        telemetry = telemetry_;
+    }
+
+    /*
+    Анализируем весь вход, возвращает число позиций
+    */
+    long long BatchAnalyzer::run(std::istream& input, bool isBinary_, std::ostream& output_)
+    {
+        isBinary = isBinary_;
+        output = &output_;
+        nextOutput = 0;
+        inputFinished = false;
+
+        std::vector<std::thread> workers;
+        for (int x = 0; x < threads; ++x) {
+            workers.push_back(std::thread(&BatchAnalyzer::work, this));
+        }
+
+        long long count = 0;
+        std::string record;
+        while (true) {
+            if (isBinary) {
+                record.resize(BATCH_RECORD_SIZE);
+                if (!input.read(&record[0], BATCH_RECORD_SIZE)) {
+                    break;
+                }
+            }
+            else if (!std::getline(input, record)) {
+                break;
+            }
+            else if (record.empty() || record[0] == '#') {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            spaceCondition.wait(lock, [&]() { return count - nextOutput < (long long)window; });
+            Task task = { count++, record };
+            tasks.push_back(task);
+            taskCondition.notify_one();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inputFinished = true;
+        }
+        taskCondition.notify_all();
+        for (size_t x = 0; x < workers.size(); ++x) {
+            workers[x].join();
+        }
+        output->flush();
+        return count;
+    }
+
+    /*
+    Рабочий поток: у каждого свой движок, чтобы хэш-таблица решателя не создавалась на каждую позицию
+    */
+    void BatchAnalyzer::work()
+    {
+        Reversi engine;
+        engine.setTimeLimit(0);
+        engine.setMaxDepth(depth > 0 ? depth + 1 : MAX_PLY);
+        engine.setNodeLimit(nodeLimit);
+        engine.setEndgameEmpties(endgameEmpties);
+        if (patterns != nullptr) {
+            engine.setPatternEvaluator(patterns);
+        }
+        engine.setProbCut(probCut);
+        engine.setLateMoveReductions(isReductionEnabled);
+        engine.setTelemetry(telemetry, "batch");
+
+        while (true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                taskCondition.wait(lock, [&]() { return !tasks.empty() || inputFinished; });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = tasks.front();
+                tasks.pop_front();
+            }
+
+            std::string result = analyze(engine, task);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            results[task.index] = result;
+            bool isWritten = false;
+            std::map<long long, std::string>::iterator next;
+            while ((next = results.find(nextOutput)) != results.end()) { // выводим всё, что готово по порядку
+                *output << next->second << '\n';
+                results.erase(next);
+                ++nextOutput;
+                isWritten = true;
+            }
+            if (isWritten) {
+                spaceCondition.notify_one();
+            }
+        }
+    }
+
+    std::string BatchAnalyzer::analyze(Reversi& engine, const Task& task)
+    {
+        const std::string& record = task.record;
+        Board board;
+        if (isBinary) {
+            std::string source = "#" + std::to_string(task.index);
+            Bitboard black = readBitboard(record, 0);
+            Bitboard white = readBitboard(record, 8);
+            if ((black & white) != 0) {
+                return source + " error overlapping discs";
+            }
+            if (record[16] != 0 && record[16] != 1) {
+                return source + " error bad player " + std::to_string((unsigned char)record[16]);
+            }
+            board = Board(white, black, record[16] != 0 ? WHITE : BLACK);
+        }
+        else if (!parseBoard(record, board)) {
+            return record + " error bad position";
+        }
+
+        std::string position = formatBoard(board);
+        bool player = board.getPlayerColor();
+        if (!board.isGame()) { // партия закончена, оценка - итоговая разница фишек, как у решателя
+            int result = getFinalScore(board.getBitboard(player), board.getBitboard(!player));
+            return position + " move -- score " + std::to_string(result) + " type exact depth 0 nodes 0 pv";
+        }
+        std::string pass;
+        int sign = 1;
+        if (!board.isMove(player)) { // ходящему некуда ходить - анализируем за соперника
+            board = Board(board.getBitboard(WHITE), board.getBitboard(BLACK), !player);
+            pass = "pass ";
+            sign = -1;
+        }
+
+        engine.setBoard(board);
+        engine.search();
+        int value = engine.getBestValue();
+        const char* type = "eval";
+        if (engine.isExactResult()) {
+            type = "exact";
+        }
+        else if (value == MAX_VALUE || value == -MAX_VALUE) { // см. Board::isResultKnown
+            type = "known";
+        }
+        const std::vector<int>& variation = engine.getPrincipalVariation();
+        std::string line = position + " move " + (pass.empty() ? formatMove(engine.getBestMove()) : "pass") +
+            " score " + std::to_string(sign * value) + " type " + type +
+            " depth " + std::to_string(engine.getSearchDepth()) + " nodes " + std::to_string(engine.getNodeCount()) + " pv " + pass;
+        for (size_t x = 0; x < variation.size(); ++x) {
+            line += formatMove(variation[x]) + (x + 1 < variation.size() ? " " : "");
+        }
+        return line;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include "Game.h"
+
+namespace reversi
+{
+    const size_t BATCH_RECORD_SIZE = 17; // двоичная запись: чёрные и белые (по 8 байт, младший байт первым), ходящий (0 - чёрные)
+
+    /*
+    Пакетный анализ: позиции читаются потоком (по строке формата GameRecord или двоичными записями),
+    анализируются пулом потоков на заданную глубину или число узлов, и результаты выводятся
+    в порядке входа. Между чтением и выводом держим не больше window позиций,
+    так что вход любого размера не хранится в памяти целиком.
+    Строка результата: "<позиция> move <ход> score <оценка> type <тип> depth <глубина> nodes <узлы> pv <ходы>",
+    тип задаёт единицы оценки: eval - оценочная функция (Board::getValue или шаблоны),
+    exact - точная разница фишек, known - исход решён стабильными фишками, оценка ±MAX_VALUE.
+    Позиция, которую не удалось прочитать: "<строка входа> error <причина>" в текстовом режиме,
+    "#<номер записи с нуля> error <причина>" в двоичном.
+    Лимит узлов действует и на решатель эндшпиля: не успевший решатель оставляет оценку eval
+    */
+    class BatchAnalyzer
+    {
+    public:
+        explicit BatchAnalyzer(const PatternEvaluator* patterns_);
+
+        void setThreads(int threads_);
+        void setDepth(int depth_);
+        void setNodeLimit(long long nodeLimit_);
+        void setEndgameEmpties(int endgameEmpties_);
+        void setWindow(size_t window_);
+        void setProbCut(const ProbCut* probCut_);
+        void setLateMoveReductions(bool isEnabled);
+        void setTelemetry(TelemetryLog* telemetry_);
+
+        long long run(std::istream& input, bool isBinary, std::ostream& output);
+
+    private:
+        BatchAnalyzer(const BatchAnalyzer&);
+        BatchAnalyzer& operator=(const BatchAnalyzer&);
+
+        struct Task
+        {
+            long long index;
+            std::string record; // строка или двоичная запись, разбирается уже в рабочем потоке
+        };
+
+        void work();
+        std::string analyze(Reversi& engine, const Task& task);
+
+        const PatternEvaluator* patterns;
+        const ProbCut* probCut;
+        bool isReductionEnabled;
+        TelemetryLog* telemetry;
+        int threads;
+        int depth;
+        long long nodeLimit;
+        int endgameEmpties;
+        size_t window;
+        bool isBinary;
+
+        std::mutex mutex;
+        std::condition_variable taskCondition; // появилась задача или вход закончился
+        std::condition_variable spaceCondition; // освободилось место в окне
+        std::deque<Task> tasks; // под mutex
+        std::map<long long, std::string> results; // под mutex, готовые, но ещё не выведенные
+        long long nextOutput; // под mutex, номер следующей позиции для вывода
+        bool inputFinished; // под mutex
+        std::ostream* output;
+    };
+}
@@ -0,0 +1,175 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "Endgame.h"
+#include "Game.h"
+#include "GameRecord.h"
+
+using namespace reversi;
+
+/*
+Замеры движка: корректность генератора ходов и скорость поиска.
+  Bench [perft depth] [search depth]
+Результаты - по строке JSON на каждый замер, код возврата 1, если что-то не сошлось.
+Сборка из каталога Reversi (остальные main - Source, Tournament и т. п. - не нужны):
+  g++ -std=c++14 -O2 -pthread -o Bench Bench.cpp Batch.cpp Board.cpp Endgame.cpp Game.cpp GameRecord.cpp
+      OpeningBook.cpp Pattern.cpp Ponder.cpp ProbCut.cpp Server.cpp Stability.cpp Telemetry.cpp
+*/
+
+namespace
+{
+    struct PerftPosition
+    {
+        const char* name;
+        const char* board;
+        long long leaves[10]; // число листьев на глубинах 1..10, -1 - неизвестно
+    };
+
+    // Для начальной позиции - общеизвестные значения, для остальных - сверенные
+    // с независимым битовым генератором. Пас считается ходом, закончившиеся раньше партии - нет
+    const PerftPosition PERFT_POSITIONS[] = {
+        { "start", "---------------------------OX------XO--------------------------- X",
+            { 4, 12, 56, 244, 1396, 8200, 55092, 390216, 3005288, 24571056 } },
+        { "mid1", "----------X-O----OXO-----OOXX----O-XO-----XOXOX---X---O---X----- X",
+            { 12, 169, 2014, 26343, 328700, 4192364, -1, -1, -1, -1 } },
+        { "mid2", "-----------O---O--OO-XO---XOXOOOOOOOO------X-X-----X------------ X",
+            { 11, 120, 1276, 13474, 147661, 1598362, -1, -1, -1, -1 } },
+        { "mid3", "--OOO----X-O-----XXX------XXXXX----XOX----O-XX-------X---------- X",
+            { 2, 15, 66, 665, 4398, 54908, -1, -1, -1, -1 } },
+        { "end1", "--O-X-O-OOOOXO-XOOOXOOX-OOOOXO-XOOOOXOX-OOO-XXO-OOOXXX-O----XX-- X",
+            { 11, 104, 998, 8460, 75609, 572735, -1, -1, -1, -1 } }
+    };
+
+    struct EndgamePosition
+    {
+        const char* name;
+        const char* board;
+        int score; // точный результат для ходящего
+    };
+
+    // ffo40 - позиция №40 из набора FFO (20 пустых, a2 +38). Остальные - не FFO, а позиции
+    // с 18 пустыми из случайных партий, результаты сверены с простым альфа-бета перебором
+    // без хэша и упорядочивания
+    const EndgamePosition ENDGAME_POSITIONS[] = {
+        { "ffo40", "O--OOOOX-OOOOOOXOOXXOOOXOOXOOOXXOOOOOOXX---OOOOX----O--X-------- X", 38 },
+        { "random18-1", "--O-X-O-OOOOXO-XOOOXOOX-OOOOXO-XOOOOXOX-OOO-XXO-OOOXXX-O----XX-- X", 16 },
+        { "random18-2", "---------O--OOOO--OO-X-XOOOOOXXXOOXOXOOX-OXOXOOXXXXOXOOXXXX-O-XX X", 48 },
+        { "random18-3", "--O-------OO--OO--OXOOOOXXOXOOOOOXOOOOXO-XOOOOOOX-XXXXXO-X-O-OXO X", -6 },
+        { "random18-4", "-XXXXXX-OOO-OXXX-OOOOOOO--OXOXOO-OXXXOXOO--XOXXO---X-XX----XX-OX X", 32 },
+        { "random18-5", "XOO-OO-XXOXOOOXXOOOXOOXXOOOOXOXXO-OOOXXX-XXXX--O--XX-----O-X---- X", 50 },
+        { "random18-6", "----O-XO----OXXXXXXXXOOXXXXXOOXOXXXOOXOX-XOOOOX---OXXXXX---OX-O- X", -40 }
+    };
+
+    double getMilliseconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /*
+    Перебор всех партий глубины depth через Board. Пас - отдельный ход
+    */
+    long long perft(Board& board, int depth) {
+        if (depth == 0) {
+            return 1;
+        }
+        bool player = board.getPlayerColor();
+        long long leaves = 0;
+        for (int x = 0; x < 64; ++x) {
+            if (!board.isCeilPossible(x, player)) {
+                continue;
+            }
+            Board child(board);
+            child.setCeil(x);
+            if (!child.isGame()) {
+                leaves += depth == 1 ? 1 : 0;
+            }
+            else if (child.getPlayerColor() == player) { // соперник пасует
+                leaves += depth == 1 ? 1 : perft(child, depth - 2);
+            }
+            else {
+                leaves += perft(child, depth - 1);
+            }
+        }
+        return leaves;
+    }
+
+    bool runPerft(int maxDepth) {
+        bool isOk = true;
+        for (const PerftPosition& position : PERFT_POSITIONS) {
+            Board board;
+            parseBoard(position.board, board);
+            for (int depth = 1; depth <= maxDepth; ++depth) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                long long leaves = perft(board, depth);
+                double ms = getMilliseconds(start);
+                long long expected = depth <= 10 ? position.leaves[depth - 1] : -1;
+                bool isPassed = expected < 0 || expected == leaves;
+                isOk = isOk && isPassed;
+                printf("{\"test\":\"perft\",\"position\":\"%s\",\"depth\":%d,\"leaves\":%lld,\"expected\":%lld,"
+                    "\"ok\":%s,\"ms\":%.3f,\"lps\":%.0f}\n",
+                    position.name, depth, leaves, expected, isPassed ? "true" : "false", ms,
+                    ms > 0 ? leaves * 1000.0 / ms : 0.0);
+            }
+        }
+        return isOk;
+    }
+
+    /*
+    Поиск на фиксированную глубину: узлы, время и эффективный коэффициент ветвления по итерациям
+    */
+    void runSearch(int maxDepth) {
+        for (const PerftPosition& position : PERFT_POSITIONS) {
+            Board board;
+            parseBoard(position.board, board);
+            Reversi reversi(board);
+            reversi.setTimeLimit(0);
+            long long prevNodes = 0;
+            for (int depth = 1; depth <= maxDepth; ++depth) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                int value = reversi.searchDepth(depth);
+                double ms = getMilliseconds(start);
+                long long nodes = reversi.getNodeCount();
+                printf("{\"test\":\"search\",\"position\":\"%s\",\"depth\":%d,\"move\":\"%s\",\"value\":%d,"
+                    "\"nodes\":%lld,\"ms\":%.3f,\"nps\":%.0f,\"ebf\":%.2f}\n",
+                    position.name, depth, formatMove(reversi.getBestMove()).c_str(), value, nodes, ms,
+                    ms > 0 ? nodes * 1000.0 / ms : 0.0, prevNodes > 0 ? (double)nodes / prevNodes : 0.0);
+                prevNodes = nodes;
+            }
+        }
+    }
+
+    bool runEndgame() {
+        bool isOk = true;
+        EndgameSolver solver;
+        for (const EndgamePosition& position : ENDGAME_POSITIONS) {
+            Board board;
+            parseBoard(position.board, board);
+            bool player = board.getPlayerColor();
+            Bitboard own = board.getBitboard(player);
+            Bitboard opponent = board.getBitboard(!player);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            int score = solver.solve(own, opponent, true);
+            double ms = getMilliseconds(start);
+            bool isPassed = score == position.score;
+            isOk = isOk && isPassed;
+            printf("{\"test\":\"endgame\",\"position\":\"%s\",\"empties\":%d,\"move\":\"%s\",\"score\":%d,"
+                "\"expected\":%d,\"ok\":%s,\"nodes\":%lld,\"ms\":%.3f,\"nps\":%.0f}\n",
+                position.name, 64 - popCount(own | opponent), formatMove(solver.getBestMove()).c_str(), score,
+                position.score, isPassed ? "true" : "false", solver.getNodeCount(), ms,
+                ms > 0 ? solver.getNodeCount() * 1000.0 / ms : 0.0);
+        }
+        return isOk;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int perftDepth = argc > 1 ? atoi(argv[1]) : 6;
+    int searchDepth = argc > 2 ? atoi(argv[2]) : 6;
+
+    bool isOk = runPerft(perftDepth);
+    runSearch(searchDepth);
+    isOk = runEndgame() && isOk;
+    return isOk ? 0 : 1;
+}
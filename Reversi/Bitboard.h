@@ -0,0 +1,257 @@
+#pragma once
+
+#include <cstdint>
+#include "CommonConstants.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Битовое представление доски: бит с номером index соответствует клетке index
+// (см. граф индексов в CommonConstants.h)
+
+namespace reversi
+{
+    typedef uint64_t Bitboard;
+
+    const Bitboard NOT_A_FILE = 0xfefefefefefefefeULL; // все клетки, кроме столбца a
+    const Bitboard NOT_H_FILE = 0x7f7f7f7f7f7f7f7fULL; // все клетки, кроме столбца h
+    const Bitboard FULL_BOARD = 0xffffffffffffffffULL;
+
+    /*
+    Количество единичных битов
+    */
+    inline int popCount(Bitboard bitboard) {
+#ifdef _MSC_VER
+        return (int)__popcnt64(bitboard);
+#else
+        return __builtin_popcountll(bitboard);
+#endif
+    }
+
+    /*
+    Номер младшего единичного бита (bitboard != 0)
+    */
+    inline int getFirstIndex(Bitboard bitboard) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, bitboard);
+        return (int)index;
+#else
+        return __builtin_ctzll(bitboard);
+#endif
+    }
+
+    /*
+    Номер старшего единичного бита (bitboard != 0)
+    */
+    inline int getLastIndex(Bitboard bitboard) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, bitboard);
+        return (int)index;
+#else
+        return 63 - __builtin_clzll(bitboard);
+#endif
+    }
+
+    /*
+    Смещение номера клетки при шаге в направлении direction
+    */
+    constexpr int getDirectionStep(int direction) {
+        return 8 * Y_OFFSET[direction] + X_OFFSET[direction];
+    }
+
+    /*
+    Клетки, которые остаются на доске после сдвига в направлении direction:
+    при шаге вправо не может получиться столбец a, при шаге влево - столбец h
+    */
+    constexpr Bitboard getShiftMask(int direction) {
+        return X_OFFSET[direction] > 0 ? NOT_A_FILE : (X_OFFSET[direction] < 0 ? NOT_H_FILE : FULL_BOARD);
+    }
+
+    /*
+    Таблицы клеток, строятся при компиляции из X_OFFSET/Y_OFFSET
+    */
+    struct SquareTables
+    {
+        Bitboard rays[8][64]; // клетки от index (её саму не включая) до края доски в направлении
+        Bitboard neighbors[64]; // соседние клетки по всем 8 направлениям
+    };
+
+    constexpr SquareTables makeSquareTables() {
+        SquareTables tables = {};
+        for (int index = 0; index < 64; ++index) {
+            for (int direction = 0; direction < 8; ++direction) {
+                int x = index % 8 + X_OFFSET[direction];
+                int y = index / 8 + Y_OFFSET[direction];
+                if (x >= 0 && x < 8 && y >= 0 && y < 8) {
+                    tables.neighbors[index] |= 1ULL << (8 * y + x);
+                }
+                for (; x >= 0 && x < 8 && y >= 0 && y < 8; x += X_OFFSET[direction], y += Y_OFFSET[direction]) {
+                    tables.rays[direction][index] |= 1ULL << (8 * y + x);
+                }
+            }
+        }
+        return tables;
+    }
+
+    constexpr SquareTables SQUARE_TABLES = makeSquareTables();
+
+    /*
+    Сдвиг всех фишек на одну клетку в направлении Direction
+    (направления те же, что в X_OFFSET/Y_OFFSET), вышедшие за доску отбрасываются
+    */
+    template <int Direction>
+    inline Bitboard shift(Bitboard bitboard) {
+        constexpr int STEP = getDirectionStep(Direction);
+        constexpr Bitboard MASK = getShiftMask(Direction);
+        return (STEP > 0 ? bitboard << (STEP > 0 ? STEP : 0) : bitboard >> (STEP < 0 ? -STEP : 0)) & MASK;
+    }
+
+    /*
+    То же для направления, известного только во время выполнения
+    */
+    inline Bitboard shift(Bitboard bitboard, int direction) {
+        switch (direction) {
+        case 0: return shift<0>(bitboard);
+        case 1: return shift<1>(bitboard);
+        case 2: return shift<2>(bitboard);
+        case 3: return shift<3>(bitboard);
+        case 4: return shift<4>(bitboard);
+        case 5: return shift<5>(bitboard);
+        case 6: return shift<6>(bitboard);
+        default: return shift<7>(bitboard);
+        }
+    }
+
+    /*
+    Пустые клетки, куда player может сходить, переворачивая фишки в направлении Direction
+    */
+    template <int Direction>
+    inline Bitboard getDirectionMoves(Bitboard player, Bitboard opponent, Bitboard empty) {
+        Bitboard line = shift<Direction>(player) & opponent;
+        line |= shift<Direction>(line) & opponent; // цепочка соперника не длиннее 6 фишек
+        line |= shift<Direction>(line) & opponent;
+        line |= shift<Direction>(line) & opponent;
+        line |= shift<Direction>(line) & opponent;
+        line |= shift<Direction>(line) & opponent;
+        return shift<Direction>(line) & empty;
+    }
+
+    /*
+    Все клетки, куда может сходить player
+    */
+    inline Bitboard getMoves(Bitboard player, Bitboard opponent) {
+        Bitboard empty = ~(player | opponent);
+        return getDirectionMoves<0>(player, opponent, empty) | getDirectionMoves<1>(player, opponent, empty) |
+            getDirectionMoves<2>(player, opponent, empty) | getDirectionMoves<3>(player, opponent, empty) |
+            getDirectionMoves<4>(player, opponent, empty) | getDirectionMoves<5>(player, opponent, empty) |
+            getDirectionMoves<6>(player, opponent, empty) | getDirectionMoves<7>(player, opponent, empty);
+    }
+
+    /*
+    Фишки, переворачиваемые ходом в index в направлении Direction.
+    Первая по лучу клетка, где нет фишки соперника, должна быть фишкой player;
+    для лучей к старшим битам это младший бит, к младшим - старший
+    */
+    template <int Direction>
+    inline Bitboard getDirectionFlips(Bitboard player, Bitboard opponent, int index) {
+        const Bitboard ray = SQUARE_TABLES.rays[Direction][index];
+        const Bitboard blockers = ray & ~opponent;
+        if (getDirectionStep(Direction) > 0) {
+            Bitboard first = blockers & (0 - blockers);
+            return (first & player) != 0 ? ray & (first - 1) : 0;
+        }
+        Bitboard first = 1ULL << getLastIndex(blockers | 1); // a1 подставляется, только если блокирующих нет
+        return (first & player & ray) != 0 ? ray & ~((first << 1) - 1) : 0;
+    }
+
+    /*
+    Фишки соперника, которые перевернутся при ходе player в клетку index
+    (0, если ход невозможен)
+    */
+    inline Bitboard getFlips(Bitboard player, Bitboard opponent, int index) {
+        if ((SQUARE_TABLES.neighbors[index] & opponent) == 0) { // рядом нет фишек соперника
+            return 0;
+        }
+        return getDirectionFlips<0>(player, opponent, index) | getDirectionFlips<1>(player, opponent, index) |
+            getDirectionFlips<2>(player, opponent, index) | getDirectionFlips<3>(player, opponent, index) |
+            getDirectionFlips<4>(player, opponent, index) | getDirectionFlips<5>(player, opponent, index) |
+            getDirectionFlips<6>(player, opponent, index) | getDirectionFlips<7>(player, opponent, index);
+    }
+
+    /*
+    Результат закончившейся партии с точки зрения player, пустые клетки отдаём победителю
+    */
+    inline int getFinalScore(Bitboard player, Bitboard opponent) {
+        int playerCount = popCount(player);
+        int opponentCount = popCount(opponent);
+        int empties = 64 - playerCount - opponentCount;
+        if (playerCount > opponentCount) {
+            return playerCount - opponentCount + empties;
+        }
+        if (playerCount < opponentCount) {
+            return playerCount - opponentCount - empties;
+        }
+        return 0;
+    }
+
+    /*
+    Симметрии доски: отражение по горизонтали (столбцы a <-> h)
+    */
+    inline Bitboard mirrorHorizontal(Bitboard bitboard) {
+        bitboard = ((bitboard >> 1) & 0x5555555555555555ULL) | ((bitboard & 0x5555555555555555ULL) << 1);
+        bitboard = ((bitboard >> 2) & 0x3333333333333333ULL) | ((bitboard & 0x3333333333333333ULL) << 2);
+        return ((bitboard >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((bitboard & 0x0f0f0f0f0f0f0f0fULL) << 4);
+    }
+
+    /*
+    Отражение по вертикали (строки 1 <-> 8)
+    */
+    inline Bitboard flipVertical(Bitboard bitboard) {
+        bitboard = ((bitboard >> 8) & 0x00ff00ff00ff00ffULL) | ((bitboard & 0x00ff00ff00ff00ffULL) << 8);
+        bitboard = ((bitboard >> 16) & 0x0000ffff0000ffffULL) | ((bitboard & 0x0000ffff0000ffffULL) << 16);
+        return (bitboard >> 32) | (bitboard << 32);
+    }
+
+    /*
+    Отражение относительно диагонали a1-h8
+    */
+    inline Bitboard flipDiagonal(Bitboard bitboard) {
+        Bitboard t = 0x0f0f0f0f00000000ULL & (bitboard ^ (bitboard << 28));
+        bitboard ^= t ^ (t >> 28);
+        t = 0x3333000033330000ULL & (bitboard ^ (bitboard << 14));
+        bitboard ^= t ^ (t >> 14);
+        t = 0x5500550055005500ULL & (bitboard ^ (bitboard << 7));
+        return bitboard ^ t ^ (t >> 7);
+    }
+
+    /*
+    Одна из 8 симметрий: бит 2 - отражение по диагонали, бит 0 - по горизонтали, бит 1 - по вертикали
+    */
+    inline Bitboard transform(Bitboard bitboard, int symmetry) {
+        if (symmetry & 4) {
+            bitboard = flipDiagonal(bitboard);
+        }
+        if (symmetry & 1) {
+            bitboard = mirrorHorizontal(bitboard);
+        }
+        if (symmetry & 2) {
+            bitboard = flipVertical(bitboard);
+        }
+        return bitboard;
+    }
+
+    /*
+    Симметрия, обратная к symmetry
+    */
+    inline int inverseSymmetry(int symmetry) {
+        const int INVERSE[8] = { 0, 1, 2, 3, 4, 6, 5, 7 };
+        return INVERSE[symmetry];
+    }
+
+    inline int transformIndex(int index, int symmetry) {
+        return getFirstIndex(transform(1ULL << index, symmetry));
+    }
+}
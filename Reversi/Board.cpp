@@ -1,40 +1,71 @@
 ﻿#include "Board.h"
+#include "Stability.h"
 
 
 namespace reversi {
-    Board::Board() :
-        playerColor(BLACK) // первым ходит чёрный
+    namespace
     {
-        for (int x = 0; x < 64; ++x) {
-            tableOfWhite[x] = false;
-            tableOfBlack[x] = false;
+        /*
+        Клетки, сгруппированные по весу из PRIORITIES_TABLE: сумма весов фишек считается
+        по разу popCount на каждый различный вес, а не проходом по 64 клеткам
+        */
+        struct WeightClasses
+        {
+            int count;
+            int weights[64];
+            Bitboard masks[64];
+        };
+
+        constexpr WeightClasses makeWeightClasses() {
+            WeightClasses classes = {};
+            for (int index = 0; index < 64; ++index) {
+                int weightClass = 0;
+                while (weightClass < classes.count && classes.weights[weightClass] != PRIORITIES_TABLE[index]) {
+                    ++weightClass;
+                }
+                if (weightClass == classes.count) {
+                    classes.weights[classes.count++] = PRIORITIES_TABLE[index];
+                }
+                classes.masks[weightClass] |= 1ULL << index;
+            }
+            return classes;
         }
-        tableOfWhite[27] = true;//белые клетки вначале
-        tableOfWhite[36] = true;
-        tableOfBlack[28] = true;//черные клетки вначале
-        tableOfBlack[35] = true;
-    }
 
-    Board::Board(const Board& board_) :
-        playerColor(board_.playerColor) {
-        for (int x = 0; x < 64; ++x) {
-            tableOfWhite[x] = board_.tableOfWhite[x];
-            tableOfBlack[x] = board_.tableOfBlack[x];
+        constexpr WeightClasses PRIORITY_CLASSES = makeWeightClasses();
+
+        int getPriorities(Bitboard discs) {
+            int value = 0;
+            for (int x = 0; x < PRIORITY_CLASSES.count; ++x) {
+                value += PRIORITY_CLASSES.weights[x] * popCount(discs & PRIORITY_CLASSES.masks[x]);
+            }
+            return value;
         }
     }
 
-    Board::~Board() {
+    Board::Board() :
+        playerColor(BLACK), // первым ходит чёрный
+        white((1ULL << 27) | (1ULL << 36)), //белые клетки вначале
+        black((1ULL << 28) | (1ULL << 35)) //черные клетки вначале
+    {
+    }
 
+    /*
+    Произвольная позиция по битовым маскам фишек
+    */
+    Board::Board(Bitboard white_, Bitboard black_, bool playerColor_) :
+        playerColor(playerColor_),
+        white(white_),
+        black(black_) {
     }
 
     /*
     Получить цвет выбранной клетки
     */
     int Board::getCeilColor(int index) const {
-        if (tableOfWhite[index]) {
+        if ((white >> index) & 1) {
             return WHITE_CEIL;
         }
-        if (tableOfBlack[index]) {
+        if ((black >> index) & 1) {
             return BLACK_CEIL;
         }
         return EMPTY_CEIL;
@@ -51,12 +82,7 @@ namespace reversi {
     Есть ли ещё ход?
     */
     bool Board::isMove(bool player) {
-        for (int x = 0; x < 64; ++x) {
-            if (isCeilPossible(x, player)) {
-                return true;
-            }
-        }
-        return false;
+        return getMoves(getBitboard(player), getBitboard(!player)) != 0;
     }
 
     /*
@@ -73,120 +99,99 @@ namespace reversi {
         if (getCeilColor(index) != EMPTY_CEIL) {
             return false;
         }
-
-        for (int x = 0; x < 8; ++x) {
-            if (checkMove(index, player, x, 0, false)) {
-                return true;
-            }
-        }
-        return false;
+        return getFlips(getBitboard(player), getBitboard(!player), index) != 0;
     }
 
     /*
-    Проверяет клетку на стабильность по 4-м направлениям
+    Проверяет клетку на стабильность (см. Stability.h)
     */
     bool Board::isCeilStable(int index) const {
-        int ceilColor = getCeilColor(index);
-        if (ceilColor == EMPTY_CEIL) {
+        return ((getStableDiscs() >> index) & 1) != 0;
+    }
+
+    /*
+    Битовая маска фишек игрока
+    */
+    Bitboard Board::getBitboard(bool player) const {
+        return player == WHITE ? white : black;
+    }
+
+    /*
+    Битовая маска всех стабильных фишек на доске
+    */
+    Bitboard Board::getStableDiscs() const {
+        return reversi::getStableDiscs(white, black);
+    }
+
+    /*
+    Исход партии уже решён, если у кого-то больше половины доски стабильно.
+    value - результат с точки зрения текущего игрока
+    */
+    bool Board::isResultKnown(int& value) const {
+        Bitboard own = getBitboard(playerColor);
+        Bitboard opponent = getBitboard(!playerColor);
+        if (popCount(own) <= 32 && popCount(opponent) <= 32) {
             return false;
         }
-        bool curPlayerColor;
-        if (ceilColor == WHITE_CEIL) {
-            curPlayerColor = WHITE;
-        }
-        else {
-            curPlayerColor = BLACK;
+        if (popCount(getStableDiscsOf(own, opponent)) > 32) {
+            value = MAX_VALUE;
+            return true;
         }
-
-        for (int x = 0; x < 4; ++x) {
-            if (!(checkStability(index, curPlayerColor, x) ||
-                checkStability(index, curPlayerColor, x + 4))) {
-                return false;
-            }
+        if (popCount(getStableDiscsOf(opponent, own)) > 32) {
+            value = -MAX_VALUE;
+            return true;
         }
-        return true;
+        return false;
     }
+
     /*
     * Посчитаем функцию от текущего состояния
     */
     int Board::getValue() {
-        if (!isGame()) {
-            int whiteCount = 0;
-            int blackCount = 0;
-            for (int x = 0; x < 64; ++x) {
-                if (getCeilColor(x) == WHITE_CEIL) {
-                    ++whiteCount;
-                }
-                else if (getCeilColor(x) == BLACK_CEIL) {
-                    ++blackCount;
-                }
-            }
-            if (blackCount > whiteCount) {
-                return playerColor == BLACK ? MAX_VALUE : -MAX_VALUE;
+        return getValue(DEFAULT_WEIGHTS);
+    }
+
+    int Board::getValue(const EvalWeights& weights) {
+        Bitboard own = getBitboard(playerColor);
+        Bitboard opponent = getBitboard(!playerColor);
+        Bitboard ownMoves = getMoves(own, opponent);
+        Bitboard opponentMoves = getMoves(opponent, own);
+        if (ownMoves == 0 && opponentMoves == 0) { // партия закончена
+            int difference = popCount(own) - popCount(opponent);
+            if (difference > 0) {
+                return MAX_VALUE;
             }
-            else if (blackCount < whiteCount) {
-                return playerColor == WHITE ? MAX_VALUE : -MAX_VALUE;
+            else if (difference < 0) {
+                return -MAX_VALUE;
             }
             return 0;
         }
 
-        int mobility = 0; // количество клеток, куда можно ставить
-        int stable = 0; // количество стабильных фишек с нужными весами
-        int tableValue = 0; // количество фишек нужного цвета на доске
-
-        int ceilColor;
-        if (playerColor == BLACK) {
-            ceilColor = BLACK_CEIL;
-        }
-        else {
-            ceilColor = WHITE_CEIL;
-        }
-        int currentCeilColor;
-
-        for (int x = 0; x < 64; ++x) {
-            currentCeilColor = getCeilColor(x);
-            if (isCeilPossible(x, playerColor)) {
-                ++mobility;
-            }
-            if (isCeilPossible(x, !playerColor)) {
-                --mobility;
-            }
-            if (isCeilStable(x)) {
-                if (currentCeilColor == ceilColor) {
-                    stable += PRIORITIES_TABLE[x];
-                }
-                else {
-                    stable -= PRIORITIES_TABLE[x];
-                }
-            }
-            if (currentCeilColor) {
-                if (currentCeilColor == ceilColor) {
-                    tableValue += PRIORITIES_TABLE[x];
-                }
-                else {
-                    tableValue -= PRIORITIES_TABLE[x];
-                }
-            }
-        }
-        return mobility * MOBILITY_WEIGHT + stable * STABLE_WEIGHT + tableValue * TABLE_WEIGHT;
+        int mobility = popCount(ownMoves) - popCount(opponentMoves); // разница в количестве клеток, куда можно ставить
+        Bitboard stableDiscs = getStableDiscs();
+        int stable = getPriorities(own & stableDiscs) - getPriorities(opponent & stableDiscs); // стабильные фишки с весами
+        int tableValue = getPriorities(own) - getPriorities(opponent); // все фишки с весами
+        return mobility * weights.mobility + stable * weights.stable + tableValue * weights.table;
     }
 
     /*
     * Поставить фишку в данную ячейку, если это возможно
     */
     bool Board::setCeil(int index) {
-        bool isPossible = false;
-        for (int x = 0; x < 8; x++)
-            if (checkMove(index, playerColor, x, 0, true)) {
-                isPossible = true;
-            }
-
-        if (isPossible) {
-            tableOfWhite[index] = playerColor == WHITE;
-            tableOfBlack[index] = playerColor == BLACK;
-            switchPlayer();
+        Bitboard& own = playerColor == WHITE ? white : black;
+        Bitboard& opponent = playerColor == WHITE ? black : white;
+        Bitboard move = 1ULL << index;
+        if (((own | opponent) & move) != 0) {
+            return false;
+        }
+        Bitboard flips = getFlips(own, opponent, index);
+        if (flips == 0) {
+            return false;
         }
-        return isPossible;
+        own |= flips | move;
+        opponent &= ~flips;
+        switchPlayer();
+        return true;
     }
 
     /*
@@ -199,61 +204,4 @@ namespace reversi {
         }
         return false;
     }
-
-    /*
-    Проверит, можно ли сходить в эту клетку
-    depth - глубина обхода в данном направлении
-    isToSet - нужно ли ставить
-    Если обнаружит, что можно, то рекурсивно вызовется от клеток
-    в том же направлении и перевернёт фишки
-    */
-    bool Board::checkMove(int index, bool player, int direction, int depth, bool isToSet) {
-        int x = index % 8 + X_OFFSET[direction];
-        int y = index / 8 + Y_OFFSET[direction];
-        if (x < 0 || x >= 8 || y < 0 || y >= 8) {
-            return false;
-        }
-
-        index = 8 * y + x;
-
-        if (getCeilColor(index) == EMPTY_CEIL) {
-            return false;
-        }
-        if (getCeilColor(index) == (player == WHITE ? WHITE_CEIL : BLACK_CEIL)) {
-            return depth > 0;
-        }
-
-        bool isPossible = checkMove(index, player, direction, depth + 1, isToSet);
-
-        if (isToSet && isPossible) {
-            if (player == WHITE) {
-                tableOfWhite[index] = true;
-                tableOfBlack[index] = false;
-            }
-            else {
-                tableOfWhite[index] = false;
-                tableOfBlack[index] = true;
-            }
-        }
-        return isPossible;
-    }
-
-    /*
-    Проверяем, что все клетки в выбранном направлении нужного цвета
-    */
-    bool Board::checkStability(int index, bool player, int direction) const {
-        int x = index % 8 + X_OFFSET[direction];
-        int y = index / 8 + Y_OFFSET[direction];
-        if (x < 0 || x >= 8 || y < 0 || y >= 8) {
-            return true;
-        }
-        int newIndex = 8 * y + x;
-        /*
-        * все клетки в выбранном направлении того же цвета. То есть перевернуть данную фишку уже не получится
-        */
-        if (getCeilColor(newIndex) == (player == BLACK ? BLACK_CEIL : WHITE_CEIL)) {
-            return checkStability(newIndex, player, direction);
-        }
-        return false;
-    }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include "CommonConstants.h"
+#include "Bitboard.h"
 
 namespace reversi
 {
@@ -9,8 +10,7 @@ namespace reversi
     {
     public:
         Board();
-        Board(const Board& board_);
-        ~Board();
+        Board(Bitboard white, Bitboard black, bool playerColor_);
 
         int getCeilColor(int index) const;
         bool getPlayerColor() const;
@@ -20,16 +20,19 @@ namespace reversi
         bool isCeilPossible(int index, bool player);
         bool isCeilStable(int index) const;
 
+        Bitboard getBitboard(bool player) const;
+        Bitboard getStableDiscs() const;
+        bool isResultKnown(int& value) const;
+
         bool setCeil(int index);
         int getValue();
+        int getValue(const EvalWeights& weights);
     private:
         bool switchPlayer();
-        bool checkMove(int index, bool player, int direction, int depth, bool isToSet);
-        bool checkStability(int index, bool player, int direction) const;
 
         bool playerColor; // цвет игрока
 
-        bool tableOfWhite[64]; // таблица с белыми
-        bool tableOfBlack[64]; // таблица с чёрными
+        Bitboard white; // фишки белых
+        Bitboard black; // фишки чёрных
     };
 }
\ No newline at end of file
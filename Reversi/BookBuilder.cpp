@@ -0,0 +1,181 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "Game.h"
+#include "GameRecord.h"
+#include "OpeningBook.h"
+
+using namespace reversi;
+
+/*
+Построение дебютной книги.
+  BookBuilder search <plies> <depth> <book>   - все позиции не дальше plies ходов от начала,
+                                               каждый ход оценивается поиском на глубину depth
+  BookBuilder games <games> <plies> <book>    - оценки ходов по результатам сыгранных партий;
+                                               в файле по партии в строке, ходы вида "f5 d6 c3" или "f5d6c3"
+Шкала оценок у режимов разная (оценочная функция или разница фишек * 100) и пишется в заголовок книги
+*/
+
+namespace
+{
+    const int MAX_BOOK_SCORE = 30000;
+
+    struct MoveStats
+    {
+        long long sum; // сумма оценок
+        uint32_t count;
+    };
+
+    typedef std::map<std::pair<uint64_t, int>, MoveStats> StatsMap;
+
+    int clampScore(long long score) {
+        if (score > MAX_BOOK_SCORE) {
+            return MAX_BOOK_SCORE;
+        }
+        if (score < -MAX_BOOK_SCORE) {
+            return -MAX_BOOK_SCORE;
+        }
+        return (int)score;
+    }
+
+    /*
+    Добавляем оценку хода move из позиции board (в координатах доски) в статистику
+    */
+    void addScore(StatsMap& stats, const Board& board, int move, long long score) {
+        bool player = board.getPlayerColor();
+        int symmetry;
+        uint64_t key = getBookKey(board.getBitboard(player), board.getBitboard(!player), symmetry);
+        MoveStats& moveStats = stats[std::make_pair(key, transformIndex(move, symmetry))];
+        moveStats.sum += score;
+        ++moveStats.count;
+    }
+
+    std::vector<BookEntry> getEntries(const StatsMap& stats) {
+        std::vector<BookEntry> entries;
+        for (StatsMap::const_iterator it = stats.begin(); it != stats.end(); ++it) {
+            BookEntry entry;
+            entry.key = it->first.first;
+            entry.move = (uint8_t)it->first.second;
+            entry.reserved = 0;
+            entry.count = it->second.count;
+            entry.score = (int16_t)clampScore(it->second.sum / (long long)it->second.count);
+            entries.push_back(entry);
+        }
+        return entries;
+    }
+
+    /*
+    Оценка хода поиском: значение позиции после хода с точки зрения того, кто ходил
+    */
+    int evaluateMove(const Board& board, int move, int depth) {
+        Board child(board);
+        child.setCeil(move);
+        int value;
+        if (child.isGame()) {
+            Reversi reversi(child);
+            reversi.setTimeLimit(0);
+            value = reversi.searchDepth(depth - 1);
+        }
+        else {
+            value = child.getValue();
+        }
+        return child.getPlayerColor() == board.getPlayerColor() ? value : -value;
+    }
+
+    void buildBySearch(StatsMap& stats, int plies, int depth) {
+        std::vector<Board> level(1, Board());
+        std::set<uint64_t> visited;
+        for (int ply = 0; ply < plies; ++ply) {
+            std::vector<Board> nextLevel;
+            for (size_t x = 0; x < level.size(); ++x) {
+                Board& board = level[x];
+                bool player = board.getPlayerColor();
+                int symmetry;
+                uint64_t key = getBookKey(board.getBitboard(player), board.getBitboard(!player), symmetry);
+                if (!board.isGame() || !visited.insert(key).second) {
+                    continue;
+                }
+                for (int move = 0; move < 64; ++move) {
+                    if (!board.isCeilPossible(move, player)) {
+                        continue;
+                    }
+                    addScore(stats, board, move, evaluateMove(board, move, depth));
+                    Board child(board);
+                    child.setCeil(move);
+                    nextLevel.push_back(child);
+                }
+            }
+            std::cerr << "ply " << ply << ": " << visited.size() << " positions" << std::endl;
+            level.swap(nextLevel);
+        }
+    }
+
+    /*
+    Оценка хода - итоговая разница фишек с точки зрения ходившего, умноженная на 100
+    */
+    bool buildByGames(StatsMap& stats, const std::string& path, int plies) {
+        std::ifstream input(path.c_str());
+        if (!input) {
+            return false;
+        }
+        std::string line;
+        int gameNumber = 0;
+        while (std::getline(input, line)) {
+            ++gameNumber;
+            std::vector<int> moves = parseMoves(line);
+            if (moves.empty()) {
+                continue;
+            }
+            std::vector<Board> positions;
+            int blackResult;
+            if (!replayGame(moves, positions, blackResult)) {
+                std::cerr << "game " << gameNumber << ": illegal move or unfinished game, skipped" << std::endl;
+                continue;
+            }
+            for (size_t x = 0; x < positions.size() && (int)x < plies; ++x) {
+                int result = positions[x].getPlayerColor() == BLACK ? blackResult : -blackResult;
+                addScore(stats, positions[x], moves[x], 100LL * result);
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 5) {
+        std::cerr << "usage: BookBuilder search <plies> <depth> <book>" << std::endl;
+        std::cerr << "       BookBuilder games <games> <plies> <book>" << std::endl;
+        return 1;
+    }
+    std::string mode = argv[1];
+    StatsMap stats;
+    int scoreScale;
+    if (mode == "search") {
+        scoreScale = BOOK_SCORE_EVAL;
+        buildBySearch(stats, atoi(argv[2]), atoi(argv[3]));
+    }
+    else if (mode == "games") {
+        scoreScale = BOOK_SCORE_DISCS;
+        if (!buildByGames(stats, argv[2], atoi(argv[3]))) {
+            std::cerr << "can't read " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+    else {
+        std::cerr << "unknown mode " << mode << std::endl;
+        return 1;
+    }
+
+    std::vector<BookEntry> entries = getEntries(stats);
+    if (!OpeningBook::save(argv[4], entries, scoreScale)) {
+        std::cerr << "can't write " << argv[4] << std::endl;
+        return 1;
+    }
+    std::cerr << entries.size() << " moves written" << std::endl;
+    return 0;
+}
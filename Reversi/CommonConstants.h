@@ -38,15 +38,37 @@ namespace reversi
         TABLE_WEIGHT = 5
     };
 
-    const int X_OFFSET[] = { 0,  1, 1, 1, 0, -1,  -1, -1 };
-    const int Y_OFFSET[] = { -1, -1, 0, 1, 1,  1,   0, -1 };
+    /*
+    Веса слагаемых оценки Board::getValue, у каждого движка могут быть свои
+    */
+    struct EvalWeights
+    {
+        int mobility;
+        int stable;
+        int table;
+    };
+
+    const EvalWeights DEFAULT_WEIGHTS = { MOBILITY_WEIGHT, STABLE_WEIGHT, TABLE_WEIGHT };
+
+    constexpr int X_OFFSET[] = { 0,  1, 1, 1, 0, -1,  -1, -1 };
+    constexpr int Y_OFFSET[] = { -1, -1, 0, 1, 1,  1,   0, -1 };
 
     const int MAX_VALUE = 1000000;
 
     const int MAX_DEPTH = 10;
     const int TIME_LIMIT = 3;
+    const int MAX_PLY = 64; // партия не длиннее 60 ходов, пас отдельным ходом не считается
+
+    const int PONDER_PREDICT_DEPTH = 4; // глубина поиска, которым угадываем ответ соперника
+
+    const int ENDGAME_EMPTIES = 18; // при стольких пустых клетках и меньше партия решается точно.
+                                    // 18 укладывается в TIME_LIMIT с запасом, на 20 точный счёт часто не успевает
+
+    const int LMR_FULL_MOVES = 3; // столько первых ходов узла смотрим без сокращения глубины
+    const int LMR_MIN_DEPTH = 3; // сокращаем, только если до листьев осталось не меньше
+    const int ORDER_MOBILITY_WEIGHT = 8; // вес числа ответов соперника при упорядочивании ходов
 
-    const int PRIORITIES_TABLE[64] =
+    constexpr int PRIORITIES_TABLE[64] =
     {
         200,  -3, 11,  8,  8, 11, -3, 200,
          -3,  -7, -4,  1,  1, -4, -7,  -3,
@@ -0,0 +1,562 @@
+#include <algorithm>
+#include "Endgame.h"
+#include "Stability.h"
+
+
+namespace reversi
+{
+    namespace
+    {
+        const int SCORE_INF = 65; // больше любой разницы фишек
+        const int PARITY_EMPTIES = 5; // при стольких пустых и меньше - только упорядочивание по чётности
+        const int STABILITY_EMPTIES = 6; // начиная с этого числа пустых - отсечение по стабильным фишкам
+        const int HASH_EMPTIES = 7; // начиная с этого числа пустых позиции запоминаются в хэш-таблице
+        const int ETC_EMPTIES = 10; // начиная с этого числа пустых потомков сначала ищем в хэш-таблице
+        const size_t HASH_SIZE = 1 << 18; // количество записей хэш-таблицы, степень двойки
+        const Bitboard CORNERS = 0x8100000000000081ULL;
+
+        // веса ключа сортировки ходов, меньше - раньше
+        const int ORDER_MOBILITY = 4; // за каждый ответ соперника
+        const int ORDER_CORNER = 2; // и ещё столько же, если ответ в угол
+        const int ORDER_POTENTIAL = 1; // за пустую клетку рядом с нашими фишками
+        const int ORDER_PARITY = 1; // ход в квадрант с чётным числом пустых
+
+        // четыре квадранта доски 4x4 - области, по которым считается чётность
+        const Bitboard QUADRANTS[4] = {
+            0x000000000f0f0f0fULL, 0x00000000f0f0f0f0ULL,
+            0x0f0f0f0f00000000ULL, 0xf0f0f0f000000000ULL
+        };
+
+        /*
+        Клетки в квадрантах, где нечётное число пустых. Ходить туда выгоднее -
+        в таком квадранте последний ход, скорее всего, останется за нами
+        */
+        Bitboard getOddRegions(Bitboard empty) {
+            Bitboard odd = 0;
+            for (int x = 0; x < 4; ++x) {
+                if (popCount(empty & QUADRANTS[x]) & 1) {
+                    odd |= QUADRANTS[x];
+                }
+            }
+            return odd;
+        }
+
+        /*
+        Пустые клетки рядом с фишками - туда потом, возможно, сможет пойти соперник
+        */
+        Bitboard getPotentialMoves(Bitboard discs, Bitboard empty) {
+            return (shift<0>(discs) | shift<1>(discs) | shift<2>(discs) | shift<3>(discs) |
+                shift<4>(discs) | shift<5>(discs) | shift<6>(discs) | shift<7>(discs)) & empty;
+        }
+    }
+
+    EndgameSolver::EndgameSolver() :
+        startTime(0),
+        timeLimit(0),
+        stopFlag(nullptr),
+        nodeLimit(0),
+        hashTable(HASH_SIZE),
+        bestMove(-1),
+        aborted(false),
+        nodeCount(0),
+        clockCounter(0),
+        hashProbes(0),
+        hashHits(0)
+    {
+    }
+
+    EndgameSolver::~EndgameSolver()
+    {
+    }
+
+    /*
+    Ограничение по времени, timeLimit_ <= 0 - без ограничения
+    */
+    void EndgameSolver::setTimeLimit(time_t startTime_, int timeLimit_)
+    {
+        startTime = startTime_;
+        timeLimit = timeLimit_;
+    }
+
+    /*
+    Флаг остановки из другого потока
+    */
+    void EndgameSolver::setStopFlag(const std::atomic<bool>* stopFlag_)
+    {
+        stopFlag = stopFlag_;
+    }
+
+    /*
+    Ограничение числа узлов одного решения (проверяется вместе с часами, так что
+    может быть превышено на несколько сотен узлов), 0 - без ограничения
+    */
+    void EndgameSolver::setNodeLimit(long long nodeLimit_)
+    {
+        nodeLimit = nodeLimit_;
+    }
+
+    int EndgameSolver::getBestMove() const
+    {
+        return bestMove;
+    }
+
+    bool EndgameSolver::isAborted() const
+    {
+        return aborted;
+    }
+
+    long long EndgameSolver::getNodeCount() const
+    {
+        return nodeCount;
+    }
+
+    long long EndgameSolver::getHashProbes() const
+    {
+        return hashProbes;
+    }
+
+    long long EndgameSolver::getHashHits() const
+    {
+        return hashHits;
+    }
+
+    bool EndgameSolver::isTimeOut()
+    {
+        if (stopFlag != nullptr && stopFlag->load(std::memory_order_relaxed)) {
+            return true;
+        }
+        if (nodeLimit > 0 && nodeCount >= nodeLimit) {
+            return true;
+        }
+        return timeLimit > 0 && time(NULL) - timeLimit >= startTime;
+    }
+
+    /*
+    Решаем позицию, лучший ход запоминаем в bestMove.
+    Если время вышло раньше, isAborted() == true и результату верить нельзя
+    */
+    int EndgameSolver::solve(Bitboard player, Bitboard opponent, bool isExact)
+    {
+        return isExact ? solve(player, opponent, -64, 64) : solve(player, opponent, -1, 1);
+    }
+
+    /*
+    Решение с окном (alpha, beta): точный результат, только если он внутри окна,
+    иначе - граница с нужной стороны. Окно сужают, когда знак результата уже известен
+    */
+    int EndgameSolver::solve(Bitboard player, Bitboard opponent, int alpha, int beta)
+    {
+        nodeCount = 0;
+        hashProbes = 0;
+        hashHits = 0;
+        aborted = false;
+        bestMove = -1;
+
+        int moves[64];
+        Bitboard flips[64];
+        int count = sortMoves(player, opponent, getMoves(player, opponent), moves, flips, -1);
+        if (count == 0) {
+            return -search(opponent, player, -beta, -alpha, true);
+        }
+
+        int bestValue = -SCORE_INF;
+        for (int x = 0; x < count; ++x) {
+            Bitboard newPlayer = player | flips[x] | (1ULL << moves[x]);
+            Bitboard newOpponent = opponent ^ flips[x];
+            int value;
+            if (x == 0) {
+                value = -search(newOpponent, newPlayer, -beta, -alpha, false);
+            }
+            else {
+                value = -search(newOpponent, newPlayer, -alpha - 1, -alpha, false);
+                if (value > alpha && value < beta) {
+                    value = -search(newOpponent, newPlayer, -beta, -value, false);
+                }
+            }
+            if (aborted) {
+                return 0;
+            }
+            if (value > bestValue) {
+                bestValue = value;
+                bestMove = moves[x];
+                if (value > alpha) {
+                    alpha = value;
+                }
+                if (alpha >= beta) {
+                    break;
+                }
+            }
+        }
+        return bestValue;
+    }
+
+    /*
+    Порядок "быстрейший первым": сначала ходы, после которых у соперника меньше всего ответов
+    (и меньше пустых клеток рядом с нашими фишками), при равенстве - ходы в квадранты
+    с нечётным числом пустых. Ход из хэш-таблицы всегда первый
+    */
+    int EndgameSolver::sortMoves(Bitboard player, Bitboard opponent, Bitboard moves, int* sortedMoves, Bitboard* sortedFlips, int hashMove)
+    {
+        Bitboard oddRegions = getOddRegions(~(player | opponent));
+        int keys[64];
+        int count = 0;
+        while (moves) {
+            int index = getFirstIndex(moves);
+            moves &= moves - 1;
+
+            Bitboard flips = getFlips(player, opponent, index);
+            Bitboard newPlayer = player | flips | (1ULL << index);
+            Bitboard opponentMoves = getMoves(opponent ^ flips, newPlayer);
+            int key = ORDER_MOBILITY * popCount(opponentMoves) + ORDER_CORNER * popCount(opponentMoves & CORNERS) +
+                ORDER_POTENTIAL * popCount(getPotentialMoves(newPlayer, ~(newPlayer | opponent)));
+            if (!((oddRegions >> index) & 1)) {
+                key += ORDER_PARITY;
+            }
+            if (index == hashMove) { // лучший ход из хэш-таблицы - первым
+                key = -1;
+            }
+
+            int x = count++;
+            for (; x > 0 && keys[x - 1] > key; --x) { // сортировка вставками, ходов немного
+                keys[x] = keys[x - 1];
+                sortedMoves[x] = sortedMoves[x - 1];
+                sortedFlips[x] = sortedFlips[x - 1];
+            }
+            keys[x] = key;
+            sortedMoves[x] = index;
+            sortedFlips[x] = flips;
+        }
+        return count;
+    }
+
+    /*
+    Запись хэш-таблицы для позиции или nullptr, если её там нет
+    */
+    EndgameSolver::HashEntry* EndgameSolver::getHashEntry(Bitboard player, Bitboard opponent)
+    {
+        Bitboard hash = (player * 0x9e3779b97f4a7c15ULL) ^ (opponent * 0xc2b2ae3d27d4eb4fULL);
+        HashEntry* entry = &hashTable[(hash >> 32) & (HASH_SIZE - 1)];
+        ++hashProbes;
+        if (entry->player == player && entry->opponent == opponent) {
+            ++hashHits;
+            return entry;
+        }
+        return nullptr;
+    }
+
+    /*
+    Запоминаем результат перебора с окном (alpha, beta):
+    оценка не выше alpha - верхняя граница, не ниже beta - нижняя, иначе точное значение
+    */
+    void EndgameSolver::storeHashEntry(Bitboard player, Bitboard opponent, int alpha, int beta, int value, int move)
+    {
+        Bitboard hash = (player * 0x9e3779b97f4a7c15ULL) ^ (opponent * 0xc2b2ae3d27d4eb4fULL);
+        HashEntry* entry = &hashTable[(hash >> 32) & (HASH_SIZE - 1)];
+        if (entry->player != player || entry->opponent != opponent) { // вытесняем старую позицию
+            entry->player = player;
+            entry->opponent = opponent;
+            entry->lower = -64;
+            entry->upper = 64;
+        }
+        if (value <= alpha) {
+            entry->upper = (signed char)std::min<int>(entry->upper, value);
+        }
+        else if (value >= beta) {
+            entry->lower = (signed char)std::max<int>(entry->lower, value);
+        }
+        else {
+            entry->lower = (signed char)value;
+            entry->upper = (signed char)value;
+        }
+        entry->move = (signed char)move;
+    }
+
+    /*
+    Основной перебор (много пустых): упорядочивание "быстрейший первым",
+    отсечение по стабильным фишкам и поиск с нулевым окном для всех ходов, кроме первого
+    */
+    int EndgameSolver::search(Bitboard player, Bitboard opponent, int alpha, int beta, bool passed)
+    {
+        int empties = 64 - popCount(player | opponent);
+        if (empties <= 4) {
+            return solve4(player, opponent, alpha, beta, passed);
+        }
+        if (empties <= PARITY_EMPTIES) {
+            return searchParity(player, opponent, alpha, beta, passed);
+        }
+        if (aborted || ((++clockCounter & 255) == 0 && isTimeOut())) {
+            aborted = true;
+            return 0;
+        }
+        ++nodeCount;
+
+        if (empties >= STABILITY_EMPTIES && 64 - 2 * popCount(opponent) <= alpha) { // стабильные фишки соперника уже не наши
+            int upperBound = 64 - 2 * popCount(getStableDiscsOf(opponent, player));
+            if (upperBound <= alpha) {
+                return upperBound;
+            }
+        }
+
+        int hashMove = -1;
+        int oldAlpha = alpha;
+        int oldBeta = beta;
+        bool isHashed = empties >= HASH_EMPTIES;
+        if (isHashed) {
+            HashEntry* entry = getHashEntry(player, opponent);
+            if (entry != nullptr) {
+                if (entry->lower >= beta) {
+                    return entry->lower;
+                }
+                if (entry->upper <= alpha) {
+                    return entry->upper;
+                }
+                if (entry->lower == entry->upper) {
+                    return entry->lower;
+                }
+                if (entry->lower > alpha) {
+                    alpha = entry->lower;
+                }
+                if (entry->upper < beta) {
+                    beta = entry->upper;
+                }
+                hashMove = entry->move;
+            }
+        }
+
+        int moves[64];
+        Bitboard flips[64];
+        int count = sortMoves(player, opponent, getMoves(player, opponent), moves, flips, hashMove);
+        if (count == 0) {
+            if (passed) {
+                return getFinalScore(player, opponent);
+            }
+            return -search(opponent, player, -beta, -alpha, true);
+        }
+
+        if (empties >= ETC_EMPTIES) { // вдруг какой-то потомок уже известен настолько, что отсекает сразу
+            for (int x = 0; x < count; ++x) {
+                HashEntry* entry = getHashEntry(opponent ^ flips[x], player | flips[x] | (1ULL << moves[x]));
+                if (entry != nullptr && -entry->upper >= beta) {
+                    return -entry->upper;
+                }
+            }
+        }
+
+        int bestValue = -SCORE_INF;
+        int bestIndex = -1;
+        for (int x = 0; x < count; ++x) {
+            Bitboard newPlayer = player | flips[x] | (1ULL << moves[x]);
+            Bitboard newOpponent = opponent ^ flips[x];
+            int value;
+            if (x == 0) {
+                value = -search(newOpponent, newPlayer, -beta, -alpha, false);
+            }
+            else {
+                value = -search(newOpponent, newPlayer, -alpha - 1, -alpha, false);
+                if (value > alpha && value < beta) { // нулевое окно не подтвердилось - перебираем честно
+                    value = -search(newOpponent, newPlayer, -beta, -value, false);
+                }
+            }
+            if (aborted) {
+                return 0;
+            }
+            if (value > bestValue) {
+                bestValue = value;
+                bestIndex = moves[x];
+                if (value > alpha) {
+                    alpha = value;
+                }
+                if (alpha >= beta) {
+                    break;
+                }
+            }
+        }
+        if (isHashed) {
+            storeHashEntry(player, opponent, oldAlpha, oldBeta, bestValue, bestIndex);
+        }
+        return bestValue;
+    }
+
+    /*
+    Мало пустых: сортировать дороже, чем перебрать. Сначала ходы в нечётные квадранты
+    */
+    int EndgameSolver::searchParity(Bitboard player, Bitboard opponent, int alpha, int beta, bool passed)
+    {
+        ++nodeCount;
+        Bitboard moves = getMoves(player, opponent);
+        if (moves == 0) {
+            if (passed) {
+                return getFinalScore(player, opponent);
+            }
+            return -searchParity(opponent, player, -beta, -alpha, true);
+        }
+
+        Bitboard oddRegions = getOddRegions(~(player | opponent));
+        Bitboard parts[2] = { moves & oddRegions, moves & ~oddRegions };
+        bool isLast = popCount(~(player | opponent)) == 5; // дальше - специальный случай 4-х пустых
+        int bestValue = -SCORE_INF;
+        for (int part = 0; part < 2; ++part) {
+            Bitboard curMoves = parts[part];
+            while (curMoves) {
+                int index = getFirstIndex(curMoves);
+                curMoves &= curMoves - 1;
+
+                Bitboard flips = getFlips(player, opponent, index);
+                Bitboard newPlayer = player | flips | (1ULL << index);
+                Bitboard newOpponent = opponent ^ flips;
+                int value = isLast ?
+                    -solve4(newOpponent, newPlayer, -beta, -alpha, false) :
+                    -searchParity(newOpponent, newPlayer, -beta, -alpha, false);
+                if (value > bestValue) {
+                    bestValue = value;
+                    if (value > alpha) {
+                        alpha = value;
+                    }
+                    if (alpha >= beta) {
+                        return bestValue;
+                    }
+                }
+            }
+        }
+        return bestValue;
+    }
+
+    /*
+    Не больше 4-х пустых: никакой генерации ходов, пробуем каждую пустую клетку напрямую.
+    Пустые клетки из нечётных квадрантов идут первыми
+    */
+    int EndgameSolver::solve4(Bitboard player, Bitboard opponent, int alpha, int beta, bool passed)
+    {
+        Bitboard empty = ~(player | opponent);
+        Bitboard oddRegions = getOddRegions(empty);
+        int squares[4];
+        int count = 0;
+        for (Bitboard part = empty & oddRegions; part; part &= part - 1) {
+            squares[count++] = getFirstIndex(part);
+        }
+        for (Bitboard part = empty & ~oddRegions; part; part &= part - 1) {
+            squares[count++] = getFirstIndex(part);
+        }
+
+        switch (count) {
+        case 0:
+            return getFinalScore(player, opponent);
+        case 1:
+            return solve1(player, opponent, squares[0]);
+        case 2:
+            return solve2(player, opponent, alpha, beta, squares[0], squares[1], passed);
+        case 3:
+            return solve3(player, opponent, alpha, beta, squares[0], squares[1], squares[2], passed);
+        }
+
+        ++nodeCount;
+        int bestValue = -SCORE_INF;
+        for (int x = 0; x < 4; ++x) {
+            Bitboard flips = getFlips(player, opponent, squares[x]);
+            if (flips == 0) {
+                continue;
+            }
+            int rest[3];
+            for (int y = 0, z = 0; y < 4; ++y) {
+                if (y != x) {
+                    rest[z++] = squares[y];
+                }
+            }
+            Bitboard newPlayer = player | flips | (1ULL << squares[x]);
+            int value = -solve3(opponent ^ flips, newPlayer, -beta, -alpha, rest[0], rest[1], rest[2], false);
+            if (value > bestValue) {
+                bestValue = value;
+                if (value > alpha) {
+                    alpha = value;
+                }
+                if (alpha >= beta) {
+                    return bestValue;
+                }
+            }
+        }
+        if (bestValue == -SCORE_INF) { // хода нет
+            if (passed) {
+                return getFinalScore(player, opponent);
+            }
+            return -solve4(opponent, player, -beta, -alpha, true);
+        }
+        return bestValue;
+    }
+
+    int EndgameSolver::solve3(Bitboard player, Bitboard opponent, int alpha, int beta, int x1, int x2, int x3, bool passed)
+    {
+        ++nodeCount;
+        const int squares[3] = { x1, x2, x3 };
+        int bestValue = -SCORE_INF;
+        for (int x = 0; x < 3; ++x) {
+            Bitboard flips = getFlips(player, opponent, squares[x]);
+            if (flips == 0) {
+                continue;
+            }
+            Bitboard newPlayer = player | flips | (1ULL << squares[x]);
+            int value = -solve2(opponent ^ flips, newPlayer, -beta, -alpha,
+                squares[x == 0 ? 1 : 0], squares[x == 2 ? 1 : 2], false);
+            if (value > bestValue) {
+                bestValue = value;
+                if (value > alpha) {
+                    alpha = value;
+                }
+                if (alpha >= beta) {
+                    return bestValue;
+                }
+            }
+        }
+        if (bestValue == -SCORE_INF) {
+            if (passed) {
+                return getFinalScore(player, opponent);
+            }
+            return -solve3(opponent, player, -beta, -alpha, x1, x2, x3, true);
+        }
+        return bestValue;
+    }
+
+    int EndgameSolver::solve2(Bitboard player, Bitboard opponent, int alpha, int beta, int x1, int x2, bool passed)
+    {
+        ++nodeCount;
+        int bestValue = -SCORE_INF;
+        Bitboard flips = getFlips(player, opponent, x1);
+        if (flips) {
+            bestValue = -solve1(opponent ^ flips, player | flips | (1ULL << x1), x2);
+            if (bestValue >= beta) {
+                return bestValue;
+            }
+        }
+        flips = getFlips(player, opponent, x2);
+        if (flips) {
+            int value = -solve1(opponent ^ flips, player | flips | (1ULL << x2), x1);
+            if (value > bestValue) {
+                bestValue = value;
+            }
+        }
+        if (bestValue == -SCORE_INF) {
+            if (passed) {
+                return getFinalScore(player, opponent);
+            }
+            return -solve2(opponent, player, -beta, -alpha, x1, x2, true);
+        }
+        return bestValue;
+    }
+
+    /*
+    Последняя пустая клетка: результат считается сразу по числу переворачиваемых фишек
+    */
+    int EndgameSolver::solve1(Bitboard player, Bitboard opponent, int x1)
+    {
+        ++nodeCount;
+        int playerCount = popCount(player); // соперник - 63 - playerCount
+        Bitboard flips = getFlips(player, opponent, x1);
+        if (flips) {
+            return 2 * (playerCount + popCount(flips)) - 62;
+        }
+        flips = getFlips(opponent, player, x1);
+        if (flips) {
+            return 2 * (playerCount - popCount(flips)) - 64;
+        }
+        return playerCount > 31 ? 2 * playerCount - 62 : 2 * playerCount - 64; // никто не может сходить
+    }
+}
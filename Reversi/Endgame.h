@@ -0,0 +1,73 @@
+#pragma once
+
+#include <ctime>
+#include <atomic>
+#include <vector>
+#include "CommonConstants.h"
+#include "Bitboard.h"
+
+namespace reversi
+{
+    /*
+    Точный решатель эндшпиля. Считает разницу фишек при идеальной игре обеих сторон
+    (пустые клетки в конце партии достаются победителю)
+    */
+    class EndgameSolver
+    {
+        /*
+        Запись хэш-таблицы: известные границы оценки позиции и лучший ход в ней
+        */
+        struct HashEntry
+        {
+            Bitboard player;
+            Bitboard opponent;
+            signed char lower;
+            signed char upper;
+            signed char move;
+        };
+
+    public:
+        EndgameSolver();
+        ~EndgameSolver();
+
+        void setTimeLimit(time_t startTime_, int timeLimit_);
+        void setStopFlag(const std::atomic<bool>* stopFlag_);
+        void setNodeLimit(long long nodeLimit_);
+
+        int solve(Bitboard player, Bitboard opponent, bool isExact); // isExact == false - только победа/ничья/поражение
+        int solve(Bitboard player, Bitboard opponent, int alpha, int beta);
+        int getBestMove() const;
+        bool isAborted() const;
+        long long getNodeCount() const;
+        long long getHashProbes() const;
+        long long getHashHits() const;
+
+    private:
+        int search(Bitboard player, Bitboard opponent, int alpha, int beta, bool passed);
+        int searchParity(Bitboard player, Bitboard opponent, int alpha, int beta, bool passed);
+        int solve4(Bitboard player, Bitboard opponent, int alpha, int beta, bool passed);
+        int solve3(Bitboard player, Bitboard opponent, int alpha, int beta, int x1, int x2, int x3, bool passed);
+        int solve2(Bitboard player, Bitboard opponent, int alpha, int beta, int x1, int x2, bool passed);
+        int solve1(Bitboard player, Bitboard opponent, int x1);
+
+        int sortMoves(Bitboard player, Bitboard opponent, Bitboard moves, int* sortedMoves, Bitboard* sortedFlips, int hashMove);
+        bool isTimeOut();
+
+        HashEntry* getHashEntry(Bitboard player, Bitboard opponent);
+        void storeHashEntry(Bitboard player, Bitboard opponent, int alpha, int beta, int value, int move);
+
+        time_t startTime;
+        int timeLimit;
+        const std::atomic<bool>* stopFlag;
+        long long nodeLimit; // 0 - без ограничения
+
+        std::vector<HashEntry> hashTable;
+
+        int bestMove;
+        bool aborted;
+        long long nodeCount;
+        unsigned clockCounter; // часы проверяем раз в 256 узлов основного перебора
+        long long hashProbes;
+        long long hashHits;
+    };
+}
@@ -1,10 +1,63 @@
-﻿#include "Game.h"
+﻿#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "Game.h"
+#include "GameRecord.h"
 
 
 namespace reversi
 {
     Reversi::Reversi() :
-        board(new Board)
+        board(new Board),
+        book(nullptr),
+        patterns(nullptr),
+        probCut(nullptr),
+        isReductionEnabled(false),
+        stopFlag(nullptr),
+        telemetry(nullptr),
+        telemetryName("main"),
+        timeLimit(TIME_LIMIT),
+        maxDepth(MAX_DEPTH),
+        endgameEmpties(ENDGAME_EMPTIES),
+        weights(DEFAULT_WEIGHTS),
+        nodeLimit(0),
+        curBestMove(-1),
+        bestMove(-1),
+        bestValue(0),
+        completedDepth(0),
+        isExact(false),
+        nodeCount(0),
+        counters()
+    {
+    }
+
+    /*
+    Игра с произвольной позиции
+    */
+    Reversi::Reversi(const Board& board_) :
+        board(new Board(board_)),
+        book(nullptr),
+        patterns(nullptr),
+        probCut(nullptr),
+        isReductionEnabled(false),
+        stopFlag(nullptr),
+        telemetry(nullptr),
+        telemetryName("main"),
+        timeLimit(TIME_LIMIT),
+        maxDepth(MAX_DEPTH),
+        endgameEmpties(ENDGAME_EMPTIES),
+        weights(DEFAULT_WEIGHTS),
+        nodeLimit(0),
+        curBestMove(-1),
+        bestMove(-1),
+        bestValue(0),
+        completedDepth(0),
+        isExact(false),
+        nodeCount(0),
+        counters()
     {
     }
 
@@ -37,26 +90,375 @@ namespace reversi
         if (!isGame()) {
             return -1;
         }
+        if (book != nullptr && book->getMove(*board, bestMove)) { // позиция есть в дебютной книге
+            if (telemetry != nullptr) {
+                char line[256];
+                snprintf(line, sizeof(line), "{\"event\":\"book\",\"engine\":\"%s\",\"position\":\"%s\",\"move\":\"%s\"}",
+                    telemetryName.c_str(), formatBoard(*board).c_str(), formatMove(bestMove).c_str());
+                telemetry->write(line);
+            }
+            board->setCeil(bestMove);
+            return bestMove;
+        }
         search();
         board->setCeil(bestMove);
         return bestMove;
     }
 
+    /*
+    Лучший ход, найденный последним поиском
+    */
+    int Reversi::getBestMove() const
+    {
+        return bestMove;
+    }
+
+    int Reversi::getBestValue() const
+    {
+        return bestValue;
+    }
+
+    int Reversi::getSearchDepth() const
+    {
+        return completedDepth;
+    }
+
+    /*
+    Решён ли эндшпиль точно: тогда getBestValue - разница фишек при идеальной игре
+    */
+    bool Reversi::isExactResult() const
+    {
+        return isExact;
+    }
+
+    /*
+    Главный вариант последней законченной итерации, начиная с лучшего хода
+    */
+    const std::vector<int>& Reversi::getPrincipalVariation() const
+    {
+        return bestVariation;
+    }
+
+    long long Reversi::getNodeCount() const
+    {
+        return nodeCount;
+    }
+
+    const Board& Reversi::getBoard() const
+    {
+        return *board;
+    }
+
+    /*
+    Перейти к другой позиции, не пересоздавая движок (хэш-таблица решателя остаётся)
+    */
+    void Reversi::setBoard(const Board& board_)
+    {
+        *board = board_;
+    }
+
+    /*
+    Ограничение времени на ход в секундах, 0 - без ограничения
+    */
+    void Reversi::setTimeLimit(int timeLimit_)
+    {
+        timeLimit = timeLimit_;
+    }
+
+    /*
+    Ограничение глубины итеративного углубления
+    */
+    void Reversi::setMaxDepth(int maxDepth_)
+    {
+        maxDepth = maxDepth_;
+    }
+
+    /*
+    Ограничение числа узлов на поиск, 0 - без ограничения. Как и по времени,
+    остаётся результат последней законченной итерации. Решатель эндшпиля получает
+    остаток того же бюджета
+    */
+    void Reversi::setNodeLimit(long long nodeLimit_)
+    {
+        nodeLimit = nodeLimit_;
+    }
+
+    /*
+    Веса оценки Board::getValue для этого движка
+    */
+    void Reversi::setEvalWeights(const EvalWeights& weights_)
+    {
+        weights = weights_;
+    }
+
+    void Reversi::setOpeningBook(const OpeningBook* book_)
+    {
+        book = book_;
+    }
+
+    /*
+    Оценка по шаблонам вместо Board::getValue
+    */
+    void Reversi::setPatternEvaluator(const PatternEvaluator* patterns_)
+    {
+        patterns = patterns_;
+    }
+
+    /*
+    Параметры Multi-ProbCut, подобранные для той же оценочной функции; nullptr - выключено
+    */
+    void Reversi::setProbCut(const ProbCut* probCut_)
+    {
+        probCut = probCut_;
+    }
+
+    void Reversi::setLateMoveReductions(bool isEnabled)
+    {
+        isReductionEnabled = isEnabled;
+    }
+
+    /*
+    Журнал поиска (nullptr - не пишем), name - чем помечать строки этого движка
+    */
+    void Reversi::setTelemetry(TelemetryLog* telemetry_, const std::string& name)
+    {
+        telemetry = telemetry_;
+        telemetryName = name;
+    }
+
+    /*
+    Флаг остановки: как только он выставлен, поиск заканчивается, как при нехватке времени
+    */
+    void Reversi::setStopFlag(const std::atomic<bool>* stopFlag_)
+    {
+        stopFlag = stopFlag_;
+        solver.setStopFlag(stopFlag_);
+    }
+
+    /*
+    С какого числа пустых клеток включать точный решатель эндшпиля
+    */
+    void Reversi::setEndgameEmpties(int endgameEmpties_)
+    {
+        endgameEmpties = endgameEmpties_;
+    }
+
     /*
     Ищем наиболее полезный ход
     */
     void Reversi::search()
     {
         startTime = time(NULL);
-        for (int depth = 1; depth < MAX_DEPTH; ++depth) {
-            int value = miniMax(depth);
-            if (time(NULL) - TIME_LIMIT >= startTime) {
-                break;
+        nodeCount = 0;
+        completedDepth = 0;
+        isExact = false;
+        bestVariation.clear();
+        curBestMove = -1;
+        bestMove = getFallbackMove();
+        std::chrono::steady_clock::time_point start;
+        if (telemetry != nullptr) {
+            start = std::chrono::steady_clock::now();
+        }
+        if (!solveEndgame()) {
+            for (int depth = 1; depth < maxDepth; ++depth) {
+                int value = runIteration(depth);
+                if (isTimeOut()) {
+                    break;
+                }
+                bestMove = curBestMove;
+                bestValue = value;
+                completedDepth = depth;
+                bestVariation.assign(variations[0], variations[0] + variationLength[0]);
+                //std::cout << "depth " << x << ": "<< value  << ", Best move: " << curBestMove << std::endl;
             }
-            bestMove = curBestMove;
-            //std::cout << "depth " << x << ": "<< value  << ", Best move: " << curBestMove << std::endl;
         }
         //std::cout << "Best Move: " << bestMove << std::endl;
+        if (telemetry != nullptr) {
+            reportSearch(start);
+        }
+    }
+
+    /*
+    Поиск на фиксированную глубину, возвращает оценку позиции для ходящего
+    */
+    int Reversi::searchDepth(int depth)
+    {
+        startTime = time(NULL);
+        nodeCount = 0;
+        completedDepth = 0;
+        isExact = false;
+        curBestMove = -1;
+        bestMove = getFallbackMove();
+        int value = runIteration(depth);
+        if (isTimeOut()) { // итерацию прервали - её ходу и оценке верить нельзя
+            bestValue = 0;
+            bestVariation.clear();
+            return bestValue;
+        }
+        bestMove = curBestMove;
+        bestValue = value;
+        completedDepth = depth;
+        bestVariation.assign(variations[0], variations[0] + variationLength[0]);
+        return value;
+    }
+
+    /*
+    Ход на случай, если поиск прервут до конца первой итерации: первый по порядку сортировки.
+    -1, только если ходить некуда
+    */
+    int Reversi::getFallbackMove() const
+    {
+        bool player = board->getPlayerColor();
+        int moves[64];
+        int count = sortMoves(board->getBitboard(player), board->getBitboard(!player), 0, moves);
+        return count > 0 ? moves[0] : -1;
+    }
+
+    /*
+    Оценка незаконченной позиции с точки зрения ходящего
+    */
+    int Reversi::evaluate(Board* node)
+    {
+        ++counters.evaluations;
+        if (patterns == nullptr) {
+            return node->getValue(weights);
+        }
+        bool player = node->getPlayerColor();
+        return patterns->evaluate(node->getBitboard(player), node->getBitboard(!player));
+    }
+
+    bool Reversi::isTimeOut() const
+    {
+        if (stopFlag != nullptr && stopFlag->load(std::memory_order_relaxed)) {
+            return true;
+        }
+        if (nodeLimit > 0 && nodeCount >= nodeLimit && completedDepth > 0) { // первую итерацию доводим до конца, чтобы был ход
+            return true;
+        }
+        return timeLimit > 0 && time(NULL) - timeLimit >= startTime;
+    }
+
+    /*
+    Точный перебор до конца партии, если пустых клеток осталось мало.
+    Сначала выигрыш/ничья/проигрыш, затем, если успеваем, точная разница фишек
+    в окне, которое уже задаёт знак результата. Возвращает false, если эндшпиль ещё не начался
+    */
+    bool Reversi::solveEndgame()
+    {
+        bool player = board->getPlayerColor();
+        Bitboard own = board->getBitboard(player);
+        Bitboard opponent = board->getBitboard(!player);
+        if (64 - popCount(own | opponent) > endgameEmpties) {
+            return false;
+        }
+
+        int shallowValue = runIteration(2); // запасной ход на случай, если не успеем решить
+        if (isTimeOut()) {
+            return true;
+        }
+        bestValue = shallowValue;
+        bestMove = curBestMove;
+        completedDepth = 2;
+        bestVariation.assign(variations[0], variations[0] + variationLength[0]);
+
+        solver.setTimeLimit(startTime, timeLimit);
+        int value = runSolver(own, opponent, -1, 1);
+        if (solver.isAborted()) {
+            return true;
+        }
+        bestMove = solver.getBestMove();
+        bestVariation.assign(1, bestMove); // решатель вариант не запоминает
+
+        if (value != 0) { // ничья в окне (-1, 1) - уже точный результат
+            value = value > 0 ? runSolver(own, opponent, 0, 64) : runSolver(own, opponent, -64, 0);
+        }
+        if (!solver.isAborted()) {
+            bestMove = solver.getBestMove();
+            bestValue = value;
+            completedDepth = 64 - popCount(own | opponent);
+            isExact = true;
+            bestVariation.assign(1, bestMove);
+        }
+        return true;
+    }
+
+    /*
+    Одна итерация поиска на заданную глубину со сбором счётчиков и записью в журнал
+    */
+    int Reversi::runIteration(int depth)
+    {
+        memset(&counters, 0, sizeof(counters));
+        if (telemetry == nullptr) {
+            return miniMax(depth);
+        }
+        long long startNodes = nodeCount;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int value = miniMax(depth);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        long long nodes = nodeCount - startNodes;
+        char line[640];
+        snprintf(line, sizeof(line),
+            "{\"event\":\"iteration\",\"engine\":\"%s\",\"depth\":%d,\"value\":%d,\"move\":\"%s\","
+            "\"nodes\":%lld,\"leaves\":%lld,\"evals\":%lld,\"ms\":%.3f,\"nps\":%.0f,"
+            "\"cutoff_rate\":%.4f,\"first_move_cutoff_rate\":%.4f,\"probcut_cuts\":%lld,"
+            "\"lmr_researches\":%lld,\"aborted\":%s}",
+            telemetryName.c_str(), depth, value, curBestMove >= 0 ? formatMove(curBestMove).c_str() : "--",
+            nodes, counters.leaves, counters.evaluations, ms, ms > 0 ? nodes * 1000.0 / ms : 0.0,
+            counters.interiorNodes > 0 ? (double)counters.betaCutoffs / counters.interiorNodes : 0.0,
+            counters.betaCutoffs > 0 ? (double)counters.firstMoveCutoffs / counters.betaCutoffs : 0.0,
+            counters.probCutCuts, counters.reductionResearches, isTimeOut() ? "true" : "false");
+        telemetry->write(line);
+        return value;
+    }
+
+    /*
+    Запуск точного решателя с окном (alpha, beta), его узлы идут в общий счёт
+    и ограничены остатком nodeLimit. В журнал - узлы и попадания в хэш-таблицу
+    */
+    int Reversi::runSolver(Bitboard own, Bitboard opponent, int alpha, int beta)
+    {
+        std::chrono::steady_clock::time_point start;
+        if (telemetry != nullptr) {
+            start = std::chrono::steady_clock::now();
+        }
+        solver.setNodeLimit(nodeLimit > 0 ? std::max(nodeLimit - nodeCount, 1LL) : 0);
+        int value = solver.solve(own, opponent, alpha, beta);
+        nodeCount += solver.getNodeCount();
+        if (telemetry != nullptr) {
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            long long probes = solver.getHashProbes();
+            char line[512];
+            snprintf(line, sizeof(line),
+                "{\"event\":\"endgame\",\"engine\":\"%s\",\"mode\":\"%s\",\"empties\":%d,\"value\":%d,"
+                "\"move\":\"%s\",\"nodes\":%lld,\"ms\":%.3f,\"nps\":%.0f,\"tt_probes\":%lld,"
+                "\"tt_hit_rate\":%.4f,\"aborted\":%s}",
+                telemetryName.c_str(), beta - alpha > 2 ? "exact" : "wld", 64 - popCount(own | opponent), value,
+                solver.getBestMove() >= 0 ? formatMove(solver.getBestMove()).c_str() : "--",
+                solver.getNodeCount(), ms, ms > 0 ? solver.getNodeCount() * 1000.0 / ms : 0.0, probes,
+                probes > 0 ? (double)solver.getHashHits() / probes : 0.0, solver.isAborted() ? "true" : "false");
+            telemetry->write(line);
+        }
+        return value;
+    }
+
+    /*
+    Итог поиска хода: что выбрали, на какой глубине и за сколько
+    */
+    void Reversi::reportSearch(std::chrono::steady_clock::time_point start)
+    {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::string variation;
+        for (size_t x = 0; x < bestVariation.size(); ++x) {
+            variation += formatMove(bestVariation[x]);
+        }
+        char line[768];
+        snprintf(line, sizeof(line),
+            "{\"event\":\"search\",\"engine\":\"%s\",\"position\":\"%s\",\"move\":\"%s\",\"value\":%d,"
+            "\"depth\":%d,\"exact\":%s,\"pv\":\"%s\",\"nodes\":%lld,\"ms\":%.3f,\"nps\":%.0f}",
+            telemetryName.c_str(), formatBoard(*board).c_str(), bestMove >= 0 ? formatMove(bestMove).c_str() : "--",
+            bestValue, completedDepth, isExact ? "true" : "false", variation.c_str(), nodeCount, ms,
+            ms > 0 ? nodeCount * 1000.0 / ms : 0.0);
+        telemetry->write(line);
     }
 
     /*
@@ -67,48 +469,153 @@ namespace reversi
         return miniMax(board, 0, maxDepth, -INT_MAX, INT_MAX);
     }
 
+    /*
+    Оценка потомка с точки зрения родителя: если соперник пасует, ходит тот же игрок и знак не меняется
+    */
+    int Reversi::searchChild(Board* child, bool parentColor, int depth, const int maxDepth, int alpha, int beta)
+    {
+        if (child->getPlayerColor() != parentColor) { //если нечетная глубина
+            return -miniMax(child, depth + 1, maxDepth, -beta, -alpha);
+        }
+        return miniMax(child, depth + 1, maxDepth, alpha, beta); //если чётная глубина
+    }
+
+    /*
+    Порядок ходов: сначала ход главного варианта прошлой итерации, затем по таблице приоритетов
+    с поправкой на число ответов соперника (чем меньше ему ходов, тем лучше)
+    */
+    int Reversi::sortMoves(Bitboard own, Bitboard opponent, int depth, int* moves) const
+    {
+        int scores[64];
+        int count = 0;
+        int variationMove = depth < (int)bestVariation.size() ? bestVariation[depth] : -1;
+        for (Bitboard legal = getMoves(own, opponent); legal != 0; legal &= legal - 1) {
+            int move = getFirstIndex(legal);
+            int score = INT_MAX;
+            if (move != variationMove) {
+                Bitboard flips = getFlips(own, opponent, move);
+                Bitboard replies = getMoves(opponent & ~flips, own | flips | (1ULL << move));
+                score = PRIORITIES_TABLE[move] - ORDER_MOBILITY_WEIGHT * popCount(replies);
+            }
+            int y = count++;
+            for (; y > 0 && scores[y - 1] < score; --y) { // вставками, ходов немного
+                scores[y] = scores[y - 1];
+                moves[y] = moves[y - 1];
+            }
+            scores[y] = score;
+            moves[y] = move;
+        }
+        return count;
+    }
+
+    /*
+    Multi-ProbCut: мелкие поиски с окном, сдвинутым на t * sigma, предсказывают,
+    выйдет ли глубокий поиск за beta (или не дотянет до alpha). Если да - отсекаем сразу.
+    Проверки идут от самой мелкой: дешёвая часто уже решает, более глубокая точнее.
+    value - что вернуть при отсечении
+    */
+    bool Reversi::isProbCut(Board* node, Bitboard own, Bitboard opponent, int depth, const int maxDepth,
+        int alpha, int beta, int& value)
+    {
+        const ProbCutParams* checks = probCut->getParams(own, opponent, maxDepth - depth);
+        const int limit = MAX_VALUE / 2; // рядом с известным исходом регрессия не работает
+        bool isCut = false;
+        for (int check = 0; check < PROBCUT_CHECKS && !isCut; ++check) {
+            const ProbCutParams& params = checks[check];
+            if (params.shallow == 0 || params.a <= 0) {
+                continue;
+            }
+            if (beta < limit) {
+                int bound = (int)ceil((beta + PROBCUT_THRESHOLD * params.sigma - params.b) / params.a);
+                if (bound < limit && miniMax(node, depth, depth + params.shallow, bound - 1, bound) >= bound) {
+                    value = beta;
+                    isCut = true;
+                }
+            }
+            if (!isCut && alpha > -limit) {
+                int bound = (int)floor((alpha - PROBCUT_THRESHOLD * params.sigma - params.b) / params.a);
+                if (bound > -limit && miniMax(node, depth, depth + params.shallow, bound, bound + 1) <= bound) {
+                    value = alpha;
+                    isCut = true;
+                }
+            }
+        }
+        variationLength[depth] = depth; // мелкий поиск затёр вариант этого узла
+        return isCut;
+    }
+
     /*
     Минимакс с отсечением некоторых веток
     */
     int Reversi::miniMax(Board* node, int depth, const int maxDepth, int alpha, int beta)
     {
-        if (time(NULL) - TIME_LIMIT >= startTime) { // если время подошло к концу, то нужно заканчивать
+        ++nodeCount;
+        variationLength[depth] = depth;
+        if (isTimeOut()) { // если время подошло к концу, то нужно заканчивать
             return NULL;
         }
-        if (depth >= maxDepth || !node->isGame()) { // если получили невозможный вариант или зашли слишком глубоко
-            return node->getValue();                // то возвращаем текущее значение
+        if (!node->isGame()) { // если партия закончена, то возвращаем её результат
+            ++counters.leaves;
+            return node->getValue();
+        }
+        if (depth >= maxDepth) { // если зашли слишком глубоко, то возвращаем текущее значение
+            ++counters.leaves;
+            return evaluate(node);
         }
         int value;
-        bool curPlayerColor;
+        if (depth > 0 && node->isResultKnown(value)) { // больше половины доски стабильно - исход решён
+            ++counters.leaves;
+            return value;
+        }
+        bool curPlayerColor = node->getPlayerColor();
+        Bitboard own = node->getBitboard(curPlayerColor);
+        Bitboard opponent = node->getBitboard(!curPlayerColor);
+        if (depth > 0 && probCut != nullptr && isProbCut(node, own, opponent, depth, maxDepth, alpha, beta, value)) {
+            ++counters.probCutCuts;
+            return value;
+        }
+
+        int moves[64];
+        int count = sortMoves(own, opponent, depth, moves);
+        ++counters.interiorNodes;
         Board* child;
         /*
         * обрабатываем текущее состояние
         */
-        for (int x = 0; x < 64; ++x) {
-            if (node->isCeilPossible(x, node->getPlayerColor())) {
-                child = new Board(*node);
-                curPlayerColor = child->getPlayerColor();
-                child->setCeil(x);
-
-                if (child->getPlayerColor() != curPlayerColor) { //если нечетная глубина
-                    value = -miniMax(child, depth + 1, maxDepth, -beta, -alpha);
-                }
-                else {                                         //если чётная глубина
-                    value = miniMax(child, depth + 1, maxDepth, alpha, beta);
+        for (int x = 0; x < count; ++x) {
+            child = new Board(*node);
+            child->setCeil(moves[x]);
+
+            // поздние по порядку ходы сначала смотрим на ход мельче, полностью - только если оказались лучше
+            if (isReductionEnabled && depth > 0 && x >= LMR_FULL_MOVES && maxDepth - depth >= LMR_MIN_DEPTH) {
+                value = searchChild(child, curPlayerColor, depth, maxDepth - 1, alpha, beta);
+                if (value > alpha) {
+                    ++counters.reductionResearches;
+                    value = searchChild(child, curPlayerColor, depth, maxDepth, alpha, beta);
                 }
-                delete child;
+            }
+            else {
+                value = searchChild(child, curPlayerColor, depth, maxDepth, alpha, beta);
+            }
+            delete child;
 
-                if (value >= beta) { // текущее значение каким-то образом стало больше, чем максимум
-                    return beta;     // то есть просто максимум
+            if (value >= beta) { // текущее значение каким-то образом стало больше, чем максимум
+                ++counters.betaCutoffs;
+                counters.firstMoveCutoffs += x == 0 ? 1 : 0;
+                return beta;     // то есть просто максимум
+            }
+            if (value > alpha) { // обновили результат
+                alpha = value;
+                variations[depth][depth] = moves[x]; // вариант: этот ход и продолжение из потомка
+                for (int y = depth + 1; y < variationLength[depth + 1]; ++y) {
+                    variations[depth][y] = variations[depth + 1][y];
                 }
-                if (value > alpha) { // обновили результат
-                    alpha = value;
-                    if (depth == 0) {
-                        curBestMove = x;
-                    }
+                variationLength[depth] = std::max(variationLength[depth + 1], depth + 1);
+                if (depth == 0) {
+                    curBestMove = moves[x];
                 }
             }
-            if (time(NULL) - TIME_LIMIT >= startTime) { // если время подошло к концу, то эту глубину не рассматриваем
+            if (isTimeOut()) { // если время подошло к концу, то эту глубину не рассматриваем
                 return NULL;
             }
         }
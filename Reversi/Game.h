@@ -2,8 +2,17 @@
 
 #include <iostream>
 #include <ctime>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
 #include "CommonConstants.h"
 #include "Board.h"
+#include "Endgame.h"
+#include "OpeningBook.h"
+#include "Pattern.h"
+#include "ProbCut.h"
+#include "Telemetry.h"
 
 namespace reversi
 {
@@ -11,6 +20,7 @@ namespace reversi
     {
     public:
         Reversi();
+        explicit Reversi(const Board& board_);
         ~Reversi();
 
 
@@ -20,15 +30,71 @@ namespace reversi
 
         int callAIMove();
         void search();
+        int searchDepth(int depth);
+        int getBestMove() const;
+        int getBestValue() const;
+        int getSearchDepth() const;
+        bool isExactResult() const;
+        const std::vector<int>& getPrincipalVariation() const;
+        long long getNodeCount() const;
+        const Board& getBoard() const;
+        void setBoard(const Board& board_);
+
+        void setEndgameEmpties(int endgameEmpties_);
+        void setTimeLimit(int timeLimit_);
+        void setMaxDepth(int maxDepth_);
+        void setNodeLimit(long long nodeLimit_);
+        void setEvalWeights(const EvalWeights& weights_);
+        void setOpeningBook(const OpeningBook* book_);
+        void setPatternEvaluator(const PatternEvaluator* patterns_);
+        void setProbCut(const ProbCut* probCut_);
+        void setLateMoveReductions(bool isEnabled);
+        void setStopFlag(const std::atomic<bool>* stopFlag_);
+        void setTelemetry(TelemetryLog* telemetry_, const std::string& name);
 
     private:
+        bool solveEndgame();
+        int getFallbackMove() const;
+        bool isTimeOut() const;
+        int evaluate(Board* node);
+        int runIteration(int depth);
+        int runSolver(Bitboard own, Bitboard opponent, int alpha, int beta);
+        void reportSearch(std::chrono::steady_clock::time_point start);
         int miniMax(int maxDepth);
         int miniMax(Board* node, int depth, const int maxDepth, int alpha, int beta);
+        int searchChild(Board* child, bool parentColor, int depth, const int maxDepth, int alpha, int beta);
+        int sortMoves(Bitboard own, Bitboard opponent, int depth, int* moves) const;
+        bool isProbCut(Board* node, Bitboard own, Bitboard opponent, int depth, const int maxDepth,
+            int alpha, int beta, int& value);
 
         Board* board;
+        EndgameSolver solver;
+        const OpeningBook* book; // общая для всех, только для чтения
+        const PatternEvaluator* patterns; // тоже, nullptr - оценка Board::getValue
+        const ProbCut* probCut; // тоже, nullptr - без Multi-ProbCut
+        bool isReductionEnabled; // сокращение глубины для поздних ходов, по умолчанию выключено
+        const std::atomic<bool>* stopFlag; // выставляется из другого потока, чтобы прервать поиск
+        TelemetryLog* telemetry; // nullptr - журнал выключен
+        std::string telemetryName;
         time_t startTime;
+        int timeLimit;
+        int maxDepth;
+        int endgameEmpties;
+        EvalWeights weights;
+
+        long long nodeLimit; // 0 - без ограничения
 
         int curBestMove;
         int bestMove;
+        int bestValue; // оценка последней законченной итерации, в эндшпиле - разница фишек
+        int completedDepth; // глубина последней законченной итерации
+        bool isExact; // bestValue - точный результат решателя
+        std::vector<int> bestVariation;
+        long long nodeCount; // узлы последнего поиска
+
+        SearchCounters counters; // текущей итерации
+
+        int variationLength[MAX_PLY]; // треугольная таблица главных вариантов по глубинам
+        int variations[MAX_PLY][MAX_PLY];
     };
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include <cctype>
+#include "GameRecord.h"
+
+
+namespace reversi
+{
+    /*
+    Разбор ходов вида "f5" из строки, пробелы и регистр не важны
+    */
+    std::vector<int> parseMoves(const std::string& line) {
+        std::vector<int> moves;
+        for (size_t x = 0; x + 1 < line.size(); ++x) {
+            char column = (char)tolower(line[x]);
+            char row = line[x + 1];
+            if (column >= 'a' && column <= 'h' && row >= '1' && row <= '8') {
+                moves.push_back(8 * (row - '1') + (column - 'a'));
+                ++x;
+            }
+        }
+        return moves;
+    }
+
+    std::string formatMove(int index) {
+        std::string move;
+        move += (char)('a' + index % 8);
+        move += (char)('1' + index / 8);
+        return move;
+    }
+
+    bool parseBoard(const std::string& text, Board& board) {
+        if (text.size() < 66) {
+            return false;
+        }
+        Bitboard white = 0;
+        Bitboard black = 0;
+        for (int x = 0; x < 64; ++x) {
+            char ceil = (char)toupper(text[x]);
+            if (ceil == 'X' || ceil == '*') {
+                black |= 1ULL << x;
+            }
+            else if (ceil == 'O') {
+                white |= 1ULL << x;
+            }
+            else if (ceil != '-' && ceil != '.') {
+                return false;
+            }
+        }
+        char player = (char)toupper(text[65]);
+        if (player != 'X' && player != 'O') {
+            return false;
+        }
+        board = Board(white, black, player == 'X' ? BLACK : WHITE);
+        return true;
+    }
+
+    std::string formatBoard(const Board& board) {
+        std::string text;
+        for (int x = 0; x < 64; ++x) {
+            int ceil = board.getCeilColor(x);
+            text += ceil == BLACK_CEIL ? 'X' : (ceil == WHITE_CEIL ? 'O' : '-');
+        }
+        text += board.getPlayerColor() == BLACK ? " X" : " O";
+        return text;
+    }
+
+    bool replayGame(const std::vector<int>& moves, std::vector<Board>& positions, int& blackResult) {
+        Board board;
+        positions.clear();
+        for (size_t x = 0; x < moves.size(); ++x) {
+            positions.push_back(board);
+            if (!board.setCeil(moves[x])) {
+                return false;
+            }
+        }
+        if (board.isGame()) {
+            return false;
+        }
+        blackResult = popCount(board.getBitboard(BLACK)) - popCount(board.getBitboard(WHITE));
+        return true;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Board.h"
+
+namespace reversi
+{
+    /*
+    Записи партий: по партии в строке, ходы вида "f5 d6 c3" или "f5d6c3", пас не пишется
+    */
+
+    std::vector<int> parseMoves(const std::string& line);
+    std::string formatMove(int index);
+
+    /*
+    Позиция одной строкой: 64 символа от a1 до h8 ('X' - чёрная, 'O' - белая, '-' - пусто),
+    пробел и цвет ходящего ('X' или 'O')
+    */
+    bool parseBoard(const std::string& text, Board& board);
+    std::string formatBoard(const Board& board);
+
+    /*
+    Проигрываем партию с начальной позиции. positions - позиции перед каждым ходом,
+    blackResult - итоговая разница фишек с точки зрения чёрных.
+    false, если встретился невозможный ход или партия не доиграна
+    */
+    bool replayGame(const std::vector<int>& moves, std::vector<Board>& positions, int& blackResult);
+}
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "OpeningBook.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace reversi
+{
+    namespace
+    {
+        uint64_t mix(uint64_t x) {
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ULL;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+
+        bool isEntryLess(const BookEntry& left, const BookEntry& right) {
+            return left.key < right.key || (left.key == right.key && left.move < right.move);
+        }
+
+        bool isKeyLess(const BookEntry& entry, uint64_t key) {
+            return entry.key < key;
+        }
+    }
+
+    /*
+    Из 8 симметричных вариантов позиции выбираем наименьший и хэшируем его
+    */
+    uint64_t getBookKey(Bitboard player, Bitboard opponent, int& symmetry) {
+        Bitboard bestPlayer = player;
+        Bitboard bestOpponent = opponent;
+        symmetry = 0;
+        for (int x = 1; x < 8; ++x) {
+            Bitboard curPlayer = transform(player, x);
+            Bitboard curOpponent = transform(opponent, x);
+            if (curPlayer < bestPlayer || (curPlayer == bestPlayer && curOpponent < bestOpponent)) {
+                bestPlayer = curPlayer;
+                bestOpponent = curOpponent;
+                symmetry = x;
+            }
+        }
+        return mix(bestPlayer ^ mix(bestOpponent));
+    }
+
+    OpeningBook::OpeningBook() :
+        entries(nullptr),
+        count(0),
+        scoreScale(BOOK_SCORE_EVAL),
+        data(nullptr),
+        dataSize(0)
+#ifdef _WIN32
+        , fileHandle(INVALID_HANDLE_VALUE),
+        mappingHandle(nullptr)
+#endif
+    {
+    }
+
+    OpeningBook::~OpeningBook()
+    {
+        close();
+    }
+
+    /*
+    Отображаем файл книги в память. false, если файла нет или он испорчен
+    */
+    bool OpeningBook::load(const std::string& path)
+    {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(BookHeader)) {
+            close();
+            return false;
+        }
+        dataSize = (size_t)fileSize.QuadPart;
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle == nullptr) {
+            close();
+            return false;
+        }
+        data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(BookHeader)) {
+            ::close(fd);
+            return false;
+        }
+        dataSize = (size_t)fileStat.st_size;
+        data = mmap(nullptr, dataSize, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // отображение остаётся и после закрытия файла
+        if (data == MAP_FAILED) {
+            data = nullptr;
+        }
+#endif
+        if (data == nullptr) {
+            close();
+            return false;
+        }
+
+        const BookHeader* header = reinterpret_cast<const BookHeader*>(data);
+        size_t entriesSize = dataSize - sizeof(BookHeader); // обрезанная последняя запись или лишние байты - порча
+        if (memcmp(header->magic, BOOK_MAGIC, sizeof(BOOK_MAGIC)) != 0 || entriesSize % sizeof(BookEntry) != 0 ||
+            header->count != entriesSize / sizeof(BookEntry) ||
+            (header->scoreScale != BOOK_SCORE_EVAL && header->scoreScale != BOOK_SCORE_DISCS)) {
+            close();
+            return false;
+        }
+        count = (size_t)header->count;
+        scoreScale = (int)header->scoreScale;
+        entries = reinterpret_cast<const BookEntry*>(header + 1);
+        return true;
+    }
+
+    void OpeningBook::close()
+    {
+#ifdef _WIN32
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if (mappingHandle != nullptr) {
+            CloseHandle(mappingHandle);
+            mappingHandle = nullptr;
+        }
+        if (fileHandle != INVALID_HANDLE_VALUE) {
+            CloseHandle(fileHandle);
+            fileHandle = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (data != nullptr) {
+            munmap(data, dataSize);
+        }
+#endif
+        data = nullptr;
+        dataSize = 0;
+        entries = nullptr;
+        count = 0;
+        scoreScale = BOOK_SCORE_EVAL;
+    }
+
+    bool OpeningBook::isLoaded() const
+    {
+        return entries != nullptr;
+    }
+
+    size_t OpeningBook::getSize() const
+    {
+        return count;
+    }
+
+    /*
+    Шкала оценок загруженной книги, см. BookScoreScale
+    */
+    int OpeningBook::getScoreScale() const
+    {
+        return scoreScale;
+    }
+
+    /*
+    Лучший по оценке ход книги из текущей позиции, переведённый обратно в координаты доски
+    */
+    bool OpeningBook::getMove(const Board& board, int& move) const
+    {
+        if (!isLoaded()) {
+            return false;
+        }
+        Bitboard player = board.getBitboard(board.getPlayerColor());
+        Bitboard opponent = board.getBitboard(!board.getPlayerColor());
+        int symmetry;
+        uint64_t key = getBookKey(player, opponent, symmetry);
+
+        const BookEntry* entry = std::lower_bound(entries, entries + count, key, isKeyLess);
+        const BookEntry* best = nullptr;
+        for (; entry != entries + count && entry->key == key; ++entry) {
+            if (best == nullptr || entry->score > best->score) {
+                best = entry;
+            }
+        }
+        if (best == nullptr) {
+            return false;
+        }
+
+        int index = transformIndex(best->move, inverseSymmetry(symmetry));
+        if (!((getMoves(player, opponent) >> index) & 1)) { // коллизия хэша
+            return false;
+        }
+        move = index;
+        return true;
+    }
+
+    /*
+    Сортируем записи и пишем файл книги, scoreScale - из BookScoreScale
+    */
+    bool OpeningBook::save(const std::string& path, std::vector<BookEntry>& bookEntries, int scoreScale)
+    {
+        std::sort(bookEntries.begin(), bookEntries.end(), isEntryLess);
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        BookHeader header;
+        memcpy(header.magic, BOOK_MAGIC, sizeof(BOOK_MAGIC));
+        header.count = bookEntries.size();
+        header.scoreScale = (uint32_t)scoreScale;
+        header.reserved = 0;
+        bool isWritten = fwrite(&header, sizeof(header), 1, file) == 1;
+        if (isWritten && !bookEntries.empty()) {
+            isWritten = fwrite(bookEntries.data(), sizeof(BookEntry), bookEntries.size(), file) == bookEntries.size();
+        }
+        return fclose(file) == 0 && isWritten;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Board.h"
+
+namespace reversi
+{
+    /*
+    Запись книги: один ход из позиции и его оценка.
+    Позиция и ход хранятся в нормализованном виде (см. getBookKey)
+    */
+    struct BookEntry
+    {
+        uint64_t key; // хэш нормализованной позиции
+        int16_t score; // оценка хода с точки зрения ходящего, больше - лучше, шкала - в заголовке
+        uint8_t move; // ход в координатах нормализованной позиции
+        uint8_t reserved;
+        uint32_t count; // сколько партий или поисков стоит за оценкой
+    };
+
+    /*
+    Единицы оценок книги. Для выбора хода шкала не важна - сравниваются ходы одной позиции,
+    но читать оценки, не зная шкалы, нельзя
+    */
+    enum BookScoreScale
+    {
+        BOOK_SCORE_EVAL = 0, // оценочная функция поиска (Board::getValue)
+        BOOK_SCORE_DISCS = 1 // итоговая разница фишек сыгранных партий, умноженная на 100
+    };
+
+    /*
+    Заголовок файла книги, за ним count записей, отсортированных по (key, move)
+    */
+    struct BookHeader
+    {
+        char magic[8];
+        uint64_t count;
+        uint32_t scoreScale; // BookScoreScale
+        uint32_t reserved;
+    };
+
+    const char BOOK_MAGIC[8] = "RVBOOK2";
+
+    /*
+    Ключ позиции, одинаковый для всех 8 её симметричных вариантов.
+    symmetry - преобразование, переводящее позицию в нормализованную
+    */
+    uint64_t getBookKey(Bitboard player, Bitboard opponent, int& symmetry);
+
+    /*
+    Дебютная книга. Файл отображается в память целиком, поиск - бинарный
+    */
+    class OpeningBook
+    {
+    public:
+        OpeningBook();
+        ~OpeningBook();
+
+        bool load(const std::string& path);
+        void close();
+        bool isLoaded() const;
+        size_t getSize() const;
+        int getScoreScale() const;
+
+        bool getMove(const Board& board, int& move) const;
+
+        static bool save(const std::string& path, std::vector<BookEntry>& entries, int scoreScale);
+
+    private:
+        OpeningBook(const OpeningBook&);
+        OpeningBook& operator=(const OpeningBook&);
+
+        const BookEntry* entries;
+        size_t count;
+        int scoreScale;
+
+        void* data; // отображённый файл
+        size_t dataSize;
+#ifdef _WIN32
+        void* fileHandle;
+        void* mappingHandle;
+#endif
+    };
+}
@@ -0,0 +1,265 @@
+#include <cstdio>
+#include <cstring>
+#include "Pattern.h"
+
+
+namespace reversi
+{
+    namespace
+    {
+        const char PATTERN_MAGIC[8] = "RVPATT1";
+        const int MAX_PATTERN_SIZE = 10;
+
+        /*
+        Шаблоны в одном из положений (клетки в формате a1 = 0, h8 = 63),
+        остальные положения получаются симметриями доски
+        */
+        struct PatternShape
+        {
+            int size;
+            int squares[MAX_PATTERN_SIZE];
+        };
+
+        enum ShapeId
+        {
+            EDGE_X, CORNER_3X3, CORNER_2X5, LINE_2, LINE_3, LINE_4, DIAGONAL_8, DIAGONAL_7, DIAGONAL_6, DIAGONAL_5, DIAGONAL_4
+        };
+
+        const PatternShape SHAPES[] = {
+            { 10, { 0, 1, 2, 3, 4, 5, 6, 7, 9, 14 } },       // край + 2X
+            { 9, { 0, 1, 2, 8, 9, 10, 16, 17, 18 } },         // угол 3x3
+            { 10, { 0, 1, 2, 3, 4, 8, 9, 10, 11, 12 } },      // угол 2x5
+            { 8, { 8, 9, 10, 11, 12, 13, 14, 15 } },          // вторая линия
+            { 8, { 16, 17, 18, 19, 20, 21, 22, 23 } },        // третья линия
+            { 8, { 24, 25, 26, 27, 28, 29, 30, 31 } },        // четвёртая линия
+            { 8, { 0, 9, 18, 27, 36, 45, 54, 63 } },          // главная диагональ
+            { 7, { 1, 10, 19, 28, 37, 46, 55 } },             // диагонали короче
+            { 6, { 2, 11, 20, 29, 38, 47 } },
+            { 5, { 3, 12, 21, 30, 39 } },
+            { 4, { 4, 13, 22, 31 } }
+        };
+        const int SHAPES_COUNT = sizeof(SHAPES) / sizeof(SHAPES[0]);
+
+        const Bitboard DIAGONAL = 0x8040201008040201ULL; // a1-h8
+        const Bitboard FILE_A = 0x0101010101010101ULL;
+
+        /*
+        Клетки шаблона в исходном положении подряд в младшие биты (бит y - клетка squares[y]).
+        Диагональ собирается умножением: у каждой её клетки своя вертикаль, переносов нет
+        */
+        inline unsigned extractShape(int shape, Bitboard bitboard) {
+            switch (shape) {
+            case EDGE_X:
+                return (unsigned)((bitboard & 0xff) | ((bitboard >> 1) & 0x100) | ((bitboard >> 5) & 0x200));
+            case CORNER_3X3:
+                return (unsigned)((bitboard & 0x7) | ((bitboard >> 5) & 0x38) | ((bitboard >> 10) & 0x1c0));
+            case CORNER_2X5:
+                return (unsigned)((bitboard & 0x1f) | ((bitboard >> 3) & 0x3e0));
+            case LINE_2:
+                return (unsigned)((bitboard >> 8) & 0xff);
+            case LINE_3:
+                return (unsigned)((bitboard >> 16) & 0xff);
+            case LINE_4:
+                return (unsigned)((bitboard >> 24) & 0xff);
+            default: { // диагональ, начинающаяся на первой горизонтали в столбце shape - DIAGONAL_8
+                int column = shape - DIAGONAL_8;
+                return (unsigned)(((bitboard & (DIAGONAL << column) & ~(FILE_A * ((1ULL << column) - 1))) * FILE_A) >> (56 + column));
+            }
+            }
+        }
+
+        /*
+        Все 8 симметрий доски, symmetries[s] == transform(bitboard, s), за 7 отражений вместо 12
+        */
+        inline void getSymmetries(Bitboard bitboard, Bitboard* symmetries) {
+            symmetries[0] = bitboard;
+            symmetries[4] = flipDiagonal(bitboard);
+            symmetries[1] = mirrorHorizontal(symmetries[0]);
+            symmetries[5] = mirrorHorizontal(symmetries[4]);
+            for (int x = 0; x < 8; x += 4) {
+                symmetries[x | 2] = flipVertical(symmetries[x]);
+                symmetries[x | 3] = flipVertical(symmetries[x | 1]);
+            }
+        }
+
+        /*
+        Троичное число из двоичного: бит y маски даёт цифру 1 в разряде, соответствующем клетке y.
+        Старшая цифра - первая клетка шаблона, как при поклеточном подсчёте
+        */
+        struct TernaryTables
+        {
+            unsigned short values[MAX_PATTERN_SIZE + 1][1 << MAX_PATTERN_SIZE];
+
+            TernaryTables() {
+                for (int size = 0; size <= MAX_PATTERN_SIZE; ++size) {
+                    for (int bits = 0; bits < (1 << MAX_PATTERN_SIZE); ++bits) {
+                        int value = 0;
+                        for (int y = 0; y < size; ++y) {
+                            value = value * 3 + ((bits >> y) & 1);
+                        }
+                        values[size][bits] = (unsigned short)value;
+                    }
+                }
+            }
+        };
+
+        const TernaryTables& getTernaryTables() {
+            static const TernaryTables tables;
+            return tables;
+        }
+
+        /*
+        Все положения всех шаблонов и смещения их таблиц внутри таблицы стадии.
+        Положения, совпадающие как множества клеток, берём один раз
+        */
+        struct PatternInstances
+        {
+            int count;
+            int shape[MAX_PATTERN_INSTANCES];
+            int size[MAX_PATTERN_INSTANCES];
+            int symmetry[MAX_PATTERN_INSTANCES]; // в какой симметрии доски положение становится исходным
+            int offset[MAX_PATTERN_INSTANCES];
+            size_t stageSize;
+
+            PatternInstances() :
+                count(0),
+                stageSize(0)
+            {
+                for (int shape = 0; shape < SHAPES_COUNT; ++shape) {
+                    int tableSize = 1;
+                    for (int x = 0; x < SHAPES[shape].size; ++x) {
+                        tableSize *= 3;
+                    }
+                    std::vector<Bitboard> masks;
+                    for (int symmetry = 0; symmetry < 8; ++symmetry) {
+                        Bitboard mask = 0;
+                        for (int x = 0; x < SHAPES[shape].size; ++x) {
+                            mask |= 1ULL << transformIndex(SHAPES[shape].squares[x], symmetry);
+                        }
+                        bool isNew = true;
+                        for (size_t y = 0; y < masks.size(); ++y) {
+                            isNew = isNew && masks[y] != mask;
+                        }
+                        if (!isNew) {
+                            continue;
+                        }
+                        masks.push_back(mask);
+                        this->shape[count] = shape;
+                        size[count] = SHAPES[shape].size;
+                        this->symmetry[count] = inverseSymmetry(symmetry);
+                        offset[count] = (int)stageSize; // все положения шаблона делят одну таблицу
+                        ++count;
+                    }
+                    stageSize += tableSize;
+                }
+            }
+        };
+
+        const PatternInstances& getInstances() {
+            static const PatternInstances instances;
+            return instances;
+        }
+    }
+
+    PatternEvaluator::PatternEvaluator() :
+        loaded(false),
+        weights(getInstances().stageSize * PATTERN_STAGES, 0.0f)
+    {
+    }
+
+    PatternEvaluator::~PatternEvaluator()
+    {
+    }
+
+    /*
+    Стадия партии по числу фишек на доске
+    */
+    int PatternEvaluator::getStage(Bitboard player, Bitboard opponent)
+    {
+        int stage = (popCount(player | opponent) - 4) * PATTERN_STAGES / 61;
+        return stage < PATTERN_STAGES ? stage : PATTERN_STAGES - 1;
+    }
+
+    size_t PatternEvaluator::getStageSize() const
+    {
+        return getInstances().stageSize;
+    }
+
+    float* PatternEvaluator::getWeights(int stage)
+    {
+        return &weights[stage * getInstances().stageSize];
+    }
+
+    bool PatternEvaluator::isLoaded() const
+    {
+        return loaded;
+    }
+
+    /*
+    Номера весов всех положений шаблонов, возвращает их количество.
+    Доска поворачивается один раз в каждую из 8 симметрий, после чего любое положение
+    шаблона читается из своей симметрии как исходное - несколькими сдвигами
+    */
+    int PatternEvaluator::getFeatures(Bitboard player, Bitboard opponent, int* features) const
+    {
+        Bitboard players[8];
+        Bitboard opponents[8];
+        getSymmetries(player, players);
+        getSymmetries(opponent, opponents);
+        const PatternInstances& instances = getInstances();
+        const TernaryTables& ternary = getTernaryTables();
+        for (int x = 0; x < instances.count; ++x) {
+            const unsigned short* values = ternary.values[instances.size[x]];
+            int symmetry = instances.symmetry[x];
+            features[x] = instances.offset[x] + values[extractShape(instances.shape[x], players[symmetry])] +
+                2 * values[extractShape(instances.shape[x], opponents[symmetry])];
+        }
+        return instances.count;
+    }
+
+    int PatternEvaluator::evaluate(Bitboard player, Bitboard opponent) const
+    {
+        int features[MAX_PATTERN_INSTANCES];
+        int count = getFeatures(player, opponent, features);
+        const float* table = &weights[getStage(player, opponent) * getInstances().stageSize];
+        float value = 0;
+        for (int x = 0; x < count; ++x) {
+            value += table[features[x]];
+        }
+        return (int)(value * 100);
+    }
+
+    /*
+    Файл весов: заголовок, размер таблицы стадии, затем все таблицы подряд
+    */
+    bool PatternEvaluator::load(const std::string& path)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            return false;
+        }
+        char magic[8];
+        unsigned long long stageSize = 0;
+        bool isRead = fread(magic, sizeof(magic), 1, file) == 1 &&
+            memcmp(magic, PATTERN_MAGIC, sizeof(magic)) == 0 &&
+            fread(&stageSize, sizeof(stageSize), 1, file) == 1 &&
+            stageSize == getInstances().stageSize &&
+            fread(weights.data(), sizeof(float), weights.size(), file) == weights.size();
+        fclose(file);
+        loaded = isRead;
+        return loaded;
+    }
+
+    bool PatternEvaluator::save(const std::string& path) const
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        unsigned long long stageSize = getInstances().stageSize;
+        bool isWritten = fwrite(PATTERN_MAGIC, sizeof(PATTERN_MAGIC), 1, file) == 1 &&
+            fwrite(&stageSize, sizeof(stageSize), 1, file) == 1 &&
+            fwrite(weights.data(), sizeof(float), weights.size(), file) == weights.size();
+        return fclose(file) == 0 && isWritten;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Bitboard.h"
+
+namespace reversi
+{
+    const int PATTERN_STAGES = 6; // наборы весов для разных стадий партии
+    const int MAX_PATTERN_INSTANCES = 64;
+
+    /*
+    Оценка по шаблонам: для каждого шаблона (край+2X, угол 3x3, угол 2x5, линии, диагонали)
+    и каждого его симметричного положения клетки шаблона читаются как число в троичной системе
+    (0 - пусто, 1 - своя фишка, 2 - чужая), по нему берётся вес из таблицы текущей стадии.
+    Оценка - сумма весов, в сотых долях фишки с точки зрения ходящего
+    */
+    class PatternEvaluator
+    {
+    public:
+        PatternEvaluator();
+        ~PatternEvaluator();
+
+        bool load(const std::string& path);
+        bool save(const std::string& path) const;
+        bool isLoaded() const;
+
+        int evaluate(Bitboard player, Bitboard opponent) const;
+
+        // для обучения
+        static int getStage(Bitboard player, Bitboard opponent);
+        int getFeatures(Bitboard player, Bitboard opponent, int* features) const; // номера весов в таблице стадии
+        size_t getStageSize() const;
+        float* getWeights(int stage);
+
+    private:
+        bool loaded;
+        std::vector<float> weights; // PATTERN_STAGES таблиц подряд
+    };
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "GameRecord.h"
+#include "Pattern.h"
+
+using namespace reversi;
+
+/*
+Обучение весов шаблонов по сыгранным партиям (например, партиям самоигры).
+  PatternTrainer <games> <patterns> [epochs] [learning rate]
+Для каждой позиции партии и всех её 8 симметрий целью служит итоговая разница фишек
+с точки зрения ходящего, веса подбираются стохастическим градиентным спуском
+*/
+
+namespace
+{
+    struct Sample
+    {
+        Bitboard player;
+        Bitboard opponent;
+        float result;
+    };
+
+    bool readSamples(const std::string& path, std::vector<Sample>& samples) {
+        std::ifstream input(path.c_str());
+        if (!input) {
+            return false;
+        }
+        std::string line;
+        int games = 0;
+        while (std::getline(input, line)) {
+            std::vector<int> moves = parseMoves(line);
+            std::vector<Board> positions;
+            int blackResult;
+            if (moves.empty() || !replayGame(moves, positions, blackResult)) {
+                continue;
+            }
+            ++games;
+            for (size_t x = 0; x < positions.size(); ++x) {
+                bool player = positions[x].getPlayerColor();
+                Sample sample;
+                sample.result = (float)(player == BLACK ? blackResult : -blackResult);
+                for (int symmetry = 0; symmetry < 8; ++symmetry) {
+                    sample.player = transform(positions[x].getBitboard(player), symmetry);
+                    sample.opponent = transform(positions[x].getBitboard(!player), symmetry);
+                    samples.push_back(sample);
+                }
+            }
+        }
+        std::cerr << games << " games, " << samples.size() << " positions" << std::endl;
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: PatternTrainer <games> <patterns> [epochs] [learning rate]" << std::endl;
+        return 1;
+    }
+    int epochs = argc > 3 ? atoi(argv[3]) : 20;
+    float learningRate = argc > 4 ? (float)atof(argv[4]) : 0.01f;
+
+    std::vector<Sample> samples;
+    if (!readSamples(argv[1], samples)) {
+        std::cerr << "can't read " << argv[1] << std::endl;
+        return 1;
+    }
+
+    PatternEvaluator evaluator;
+    std::mt19937 random(2017);
+    int features[MAX_PATTERN_INSTANCES];
+    for (int epoch = 0; epoch < epochs; ++epoch) {
+        std::shuffle(samples.begin(), samples.end(), random);
+        double squaredError = 0;
+        for (size_t x = 0; x < samples.size(); ++x) {
+            const Sample& sample = samples[x];
+            float* weights = evaluator.getWeights(PatternEvaluator::getStage(sample.player, sample.opponent));
+            int count = evaluator.getFeatures(sample.player, sample.opponent, features);
+            float prediction = 0;
+            for (int y = 0; y < count; ++y) {
+                prediction += weights[features[y]];
+            }
+            float error = sample.result - prediction;
+            squaredError += error * error;
+            float step = learningRate * error / count; // ошибка делится поровну между шаблонами
+            for (int y = 0; y < count; ++y) {
+                weights[features[y]] += step;
+            }
+        }
+        std::cerr << "epoch " << epoch << ": mse " << squaredError / std::max<size_t>(samples.size(), 1) << std::endl;
+    }
+
+    if (!evaluator.save(argv[2])) {
+        std::cerr << "can't write " << argv[2] << std::endl;
+        return 1;
+    }
+    return 0;
+}
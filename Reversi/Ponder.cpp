@@ -0,0 +1,156 @@
+#include <chrono>
+#include "Ponder.h"
+
+
+namespace reversi
+{
+    namespace
+    {
+        const int NO_PREDICTION = -2;
+    }
+
+    Ponderer::Ponderer(const OpeningBook* book_, const PatternEvaluator* patterns_, const ProbCut* probCut_) :
+        book(book_),
+        patterns(patterns_),
+        probCut(probCut_),
+        isReductionEnabled(false),
+        telemetry(nullptr),
+        stopFlag(false),
+        predictedMove(NO_PREDICTION),
+        finished(true),
+        result(-1),
+        isHit(false),
+        hitTime(0)
+    {
+    }
+
+    Ponderer::~Ponderer()
+    {
+        stop();
+    }
+
+    void Ponderer::setLateMoveReductions(bool isEnabled)
+    {
+        isReductionEnabled = isEnabled;
+    }
+
+    void Ponderer::setTelemetry(TelemetryLog* telemetry_)
+    {
+        telemetry = telemetry_;
+    }
+
+    bool Ponderer::isPondering() const
+    {
+        return thread.joinable();
+    }
+
+    /*
+    Начинаем думать над позицией после нашего хода. ownColor - наш цвет
+    */
+    void Ponderer::start(const Board& board, bool ownColor)
+    {
+        stop();
+        stopFlag = false;
+        predictedMove = NO_PREDICTION;
+        finished = false;
+        result = -1;
+        isHit = false;
+        thread = std::thread(&Ponderer::run, this, board, ownColor);
+    }
+
+    /*
+    Прерываем поиск и дожидаемся потока
+    */
+    void Ponderer::stop()
+    {
+        if (thread.joinable()) {
+            stopFlag = true;
+            thread.join();
+        }
+    }
+
+    /*
+    Соперник сходил. true, если ход угадан и поиск продолжается
+    */
+    bool Ponderer::onOpponentMove(int move)
+    {
+        if (!isPondering()) {
+            return false;
+        }
+        if (predictedMove != move) { // не угадали или не успели угадать
+            stop();
+            return false;
+        }
+        isHit = true;
+        hitTime = time(NULL);
+        return true;
+    }
+
+    /*
+    Наш ход: ждём результата, но не дольше timeLimit секунд с прихода хода соперника.
+    -1, если готового хода нет и искать надо заново
+    */
+    int Ponderer::takeMove(int timeLimit)
+    {
+        if (!isPondering()) {
+            return -1;
+        }
+        if (!isHit) {
+            if (predictedMove != -1) { // ждали хода соперника, а его не было
+                stop();
+                return -1;
+            }
+            hitTime = time(NULL); // соперник пасовал, как и ожидалось
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finishedCondition.wait_until(lock, std::chrono::system_clock::from_time_t(hitTime + timeLimit),
+                [this] { return finished; });
+        }
+        stop();
+        return result;
+    }
+
+    void Ponderer::configure(Reversi& engine, const char* name)
+    {
+        engine.setTimeLimit(0); // останавливаем сами
+        engine.setStopFlag(&stopFlag);
+        if (patterns != nullptr) {
+            engine.setPatternEvaluator(patterns);
+        }
+        engine.setProbCut(probCut);
+        engine.setLateMoveReductions(isReductionEnabled);
+        engine.setTelemetry(telemetry, name);
+    }
+
+    void Ponderer::run(Board board, bool ownColor)
+    {
+        int move = -1;
+        if (board.getPlayerColor() != ownColor) { // угадываем ответ соперника
+            Reversi predictor(board);
+            configure(predictor, "predict");
+            predictor.searchDepth(PONDER_PREDICT_DEPTH);
+            if (!stopFlag && predictor.getBestMove() >= 0) {
+                predictedMove = predictor.getBestMove();
+                board.setCeil(predictedMove);
+            }
+        }
+        else {
+            predictedMove = -1; // соперник пасует, думаем сразу над своим ходом
+        }
+
+        if (!stopFlag && board.isGame() && board.getPlayerColor() == ownColor) {
+            if (book == nullptr || !book->getMove(board, move)) {
+                Reversi engine(board);
+                configure(engine, "ponder");
+                engine.search();
+                move = engine.getBestMove();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        result = move;
+        finished = true;
+        finishedCondition.notify_all();
+    }
+}
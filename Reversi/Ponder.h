@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include "Game.h"
+
+namespace reversi
+{
+    /*
+    Обдумывание во время хода соперника. В отдельном потоке угадываем ответ соперника
+    коротким поиском и сразу ищем наш ход на него.
+    Угадали - продолжаем поиск, пока не выйдет время на наш ход; не угадали - сразу бросаем
+    */
+    class Ponderer
+    {
+    public:
+        Ponderer(const OpeningBook* book_, const PatternEvaluator* patterns_, const ProbCut* probCut_);
+        ~Ponderer();
+
+        void setLateMoveReductions(bool isEnabled);
+        void setTelemetry(TelemetryLog* telemetry_);
+
+        void start(const Board& board, bool ownColor);
+        void stop();
+        bool isPondering() const;
+
+        bool onOpponentMove(int move);
+        int takeMove(int timeLimit);
+
+    private:
+        Ponderer(const Ponderer&);
+        Ponderer& operator=(const Ponderer&);
+
+        void run(Board board, bool ownColor);
+        void configure(Reversi& engine, const char* name);
+
+        const OpeningBook* book;
+        const PatternEvaluator* patterns;
+        const ProbCut* probCut;
+        bool isReductionEnabled;
+        TelemetryLog* telemetry;
+
+        std::thread thread;
+        std::atomic<bool> stopFlag;
+        std::atomic<int> predictedMove; // NO_PREDICTION, пока ответ не угадан; -1 - соперник пасует
+
+        std::mutex mutex;
+        std::condition_variable finishedCondition;
+        bool finished; // под mutex
+        int result; // под mutex, -1 - хода нет
+
+        bool isHit;
+        time_t hitTime; // когда пришёл угаданный ход соперника
+    };
+}
@@ -0,0 +1,123 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "ProbCut.h"
+
+
+namespace reversi
+{
+    namespace
+    {
+        const char PROBCUT_MAGIC[8] = "RVMPC02";
+        const ProbCutParams NO_PARAMS = { 0, 1.0f, 0.0f, 0.0f };
+        const ProbCutParams NO_CHECKS[PROBCUT_CHECKS] = {}; // shallow == 0 у всех
+
+        /*
+        Мелкий поиск должен быть строго мельче глубокого, иначе isProbCut вызывает сам себя
+        без конца. shallow == 0 - пара не подобрана, это допустимо
+        */
+        bool isValid(const ProbCutParams& params, int depth) {
+            if (params.shallow == 0) {
+                return true;
+            }
+            return params.shallow > 0 && params.shallow < depth &&
+                std::isfinite(params.a) && std::isfinite(params.b) &&
+                std::isfinite(params.sigma) && params.sigma >= 0;
+        }
+    }
+
+    ProbCut::ProbCut() :
+        loaded(false)
+    {
+        for (int stage = 0; stage < PATTERN_STAGES; ++stage) {
+            for (int depth = 0; depth <= PROBCUT_MAX_DEPTH; ++depth) {
+                for (int check = 0; check < PROBCUT_CHECKS; ++check) {
+                    params[stage][depth][check] = NO_PARAMS;
+                }
+            }
+        }
+    }
+
+    ProbCut::~ProbCut()
+    {
+    }
+
+    bool ProbCut::isLoaded() const
+    {
+        return loaded;
+    }
+
+    /*
+    Проверки для позиции и оставшейся глубины глубокого поиска, от самой мелкой
+    */
+    const ProbCutParams* ProbCut::getParams(Bitboard player, Bitboard opponent, int depth) const
+    {
+        if (depth < PROBCUT_MIN_DEPTH || depth > PROBCUT_MAX_DEPTH) {
+            return NO_CHECKS;
+        }
+        return params[PatternEvaluator::getStage(player, opponent)][depth];
+    }
+
+    void ProbCut::setParams(int stage, int depth, int check, const ProbCutParams& params_)
+    {
+        params[stage][depth][check] = params_;
+    }
+
+    /*
+    Последняя проверка - примерно половина глубины, каждая предыдущая - вдвое мельче.
+    Глубина той же чётности: оценки после своего хода и после хода соперника
+    заметно различаются, регрессия между ними хуже. 0 - для такой глубины проверки нет
+    (слишком мелко или совпала с соседней)
+    */
+    int ProbCut::getShallowDepth(int depth, int check)
+    {
+        int shallow = depth >> (PROBCUT_CHECKS - check);
+        if ((depth - shallow) % 2 != 0) {
+            --shallow;
+        }
+        if (shallow < 1 || (check + 1 < PROBCUT_CHECKS && shallow >= getShallowDepth(depth, check + 1))) {
+            return 0;
+        }
+        return shallow;
+    }
+
+    bool ProbCut::load(const std::string& path)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            return false;
+        }
+        char magic[8];
+        ProbCutParams newParams[PATTERN_STAGES][PROBCUT_MAX_DEPTH + 1][PROBCUT_CHECKS];
+        size_t count = PATTERN_STAGES * (PROBCUT_MAX_DEPTH + 1) * PROBCUT_CHECKS;
+        bool isRead = fread(magic, sizeof(magic), 1, file) == 1 &&
+            memcmp(magic, PROBCUT_MAGIC, sizeof(magic)) == 0 &&
+            fread(newParams, sizeof(ProbCutParams), count, file) == count;
+        fclose(file);
+        for (int stage = 0; stage < PATTERN_STAGES && isRead; ++stage) {
+            for (int depth = 0; depth <= PROBCUT_MAX_DEPTH && isRead; ++depth) {
+                for (int check = 0; check < PROBCUT_CHECKS && isRead; ++check) {
+                    isRead = isValid(newParams[stage][depth][check], depth);
+                }
+            }
+        }
+        if (!isRead) { // прежние параметры остаются как были
+            return false;
+        }
+        memcpy(params, newParams, sizeof(params));
+        loaded = true;
+        return loaded;
+    }
+
+    bool ProbCut::save(const std::string& path) const
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        size_t count = PATTERN_STAGES * (PROBCUT_MAX_DEPTH + 1) * PROBCUT_CHECKS;
+        bool isWritten = fwrite(PROBCUT_MAGIC, sizeof(PROBCUT_MAGIC), 1, file) == 1 &&
+            fwrite(params, sizeof(ProbCutParams), count, file) == count;
+        return fclose(file) == 0 && isWritten;
+    }
+}
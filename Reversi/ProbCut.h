@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include "Bitboard.h"
+#include "Pattern.h"
+
+namespace reversi
+{
+    const int PROBCUT_MIN_DEPTH = 3; // на меньшей оставшейся глубине мелкий поиск ничего не экономит
+    const int PROBCUT_MAX_DEPTH = 16;
+    const float PROBCUT_THRESHOLD = 1.5f; // отсекаем, если глубокий поиск выйдет за окно с вероятностью ~93%
+    const int PROBCUT_CHECKS = 2; // мелких поисков на одну глубину: около depth / 4 и около depth / 2
+
+    /*
+    Связь мелкого и глубокого поиска: deep ~ a * shallow + b, sigma - стандартное отклонение ошибки.
+    shallow == 0 - пара не подобрана, отсечение не делаем
+    */
+    struct ProbCutParams
+    {
+        int shallow;
+        float a;
+        float b;
+        float sigma;
+    };
+
+    /*
+    Параметры Multi-ProbCut для каждой стадии партии (как у шаблонов) и оставшейся глубины:
+    по PROBCUT_CHECKS пар (мелкая глубина, регрессия), от самой мелкой к самой глубокой.
+    Подбираются регрессией по позициям партий программой ProbCutFitter и годятся
+    только для той оценочной функции, с которой подбирались
+    */
+    class ProbCut
+    {
+    public:
+        ProbCut();
+        ~ProbCut();
+
+        bool load(const std::string& path);
+        bool save(const std::string& path) const;
+        bool isLoaded() const;
+
+        const ProbCutParams* getParams(Bitboard player, Bitboard opponent, int depth) const; // PROBCUT_CHECKS проверок
+        void setParams(int stage, int depth, int check, const ProbCutParams& params);
+
+        static int getShallowDepth(int depth, int check); // глубина мелкого поиска проверки при подборе, 0 - нет
+
+    private:
+        bool loaded;
+        ProbCutParams params[PATTERN_STAGES][PROBCUT_MAX_DEPTH + 1][PROBCUT_CHECKS];
+    };
+}
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Game.h"
+#include "GameRecord.h"
+
+using namespace reversi;
+
+/*
+Подбор параметров Multi-ProbCut по позициям сыгранных партий.
+  ProbCutFitter <games> <probcut> [patterns] [max depth] [step]
+Каждую step-ю позицию партии ищем на глубины от 1 до max depth и для каждой пары
+(глубина, ProbCut::getShallowDepth(глубина, проверка)) и стадии считаем линейную регрессию
+глубокой оценки по мелкой. Оценочная функция должна совпадать с той, что будет в игре:
+без [patterns] (или с "-") - Board::getValue
+*/
+
+namespace
+{
+    /*
+    Накопленные суммы для регрессии deep = a * shallow + b
+    */
+    struct Regression
+    {
+        double count;
+        double sumX;
+        double sumY;
+        double sumXX;
+        double sumXY;
+        double sumYY;
+    };
+
+    int getRegressionIndex(int stage, int depth, int check) {
+        return (stage * (PROBCUT_MAX_DEPTH + 1) + depth) * PROBCUT_CHECKS + check;
+    }
+
+    void addSample(Regression& regression, double x, double y) {
+        regression.count += 1;
+        regression.sumX += x;
+        regression.sumY += y;
+        regression.sumXX += x * x;
+        regression.sumXY += x * y;
+        regression.sumYY += y * y;
+    }
+
+    bool fit(const Regression& regression, ProbCutParams& params) {
+        const double MIN_SAMPLES = 30;
+        double n = regression.count;
+        double variance = n * regression.sumXX - regression.sumX * regression.sumX;
+        if (n < MIN_SAMPLES || variance <= 0) {
+            return false;
+        }
+        double a = (n * regression.sumXY - regression.sumX * regression.sumY) / variance;
+        double b = (regression.sumY - a * regression.sumX) / n;
+        // сумма квадратов остатков через накопленные суммы
+        double residual = regression.sumYY - 2 * a * regression.sumXY - 2 * b * regression.sumY +
+            a * a * regression.sumXX + 2 * a * b * regression.sumX + n * b * b;
+        params.a = (float)a;
+        params.b = (float)b;
+        params.sigma = (float)sqrt(std::max(residual, 0.0) / n);
+        return a > 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: ProbCutFitter <games> <probcut> [patterns] [max depth] [step]" << std::endl;
+        return 1;
+    }
+    PatternEvaluator patterns;
+    if (argc > 3 && std::string(argv[3]) != "-" && !patterns.load(argv[3])) {
+        std::cerr << "can't load patterns " << argv[3] << std::endl;
+        return 1;
+    }
+    int maxDepth = argc > 4 ? atoi(argv[4]) : 8;
+    int step = argc > 5 ? atoi(argv[5]) : 4;
+    maxDepth = std::min(std::max(maxDepth, PROBCUT_MIN_DEPTH), PROBCUT_MAX_DEPTH);
+    step = std::max(step, 1);
+
+    std::ifstream input(argv[1]);
+    if (!input) {
+        std::cerr << "can't read " << argv[1] << std::endl;
+        return 1;
+    }
+
+    Reversi engine;
+    engine.setTimeLimit(0);
+    engine.setLateMoveReductions(false); // регрессия - для полного перебора
+    if (patterns.isLoaded()) {
+        engine.setPatternEvaluator(&patterns);
+    }
+
+    std::vector<Regression> regressions(PATTERN_STAGES * (PROBCUT_MAX_DEPTH + 1) * PROBCUT_CHECKS, Regression());
+    std::vector<int> values(maxDepth + 1);
+    std::string line;
+    int games = 0;
+    long long positions = 0;
+    while (std::getline(input, line)) {
+        std::vector<Board> boards;
+        int blackResult;
+        if (!replayGame(parseMoves(line), boards, blackResult)) {
+            continue;
+        }
+        ++games;
+        for (size_t x = games % step; x < boards.size(); x += step) { // сдвиг, чтобы брать разные ходы разных партий
+            Board board = boards[x];
+            bool player = board.getPlayerColor();
+            if (64 - popCount(board.getBitboard(player) | board.getBitboard(!player)) <= maxDepth) {
+                continue; // глубокий поиск дошёл бы до конца партии
+            }
+            engine.setBoard(board);
+            for (int depth = 1; depth <= maxDepth; ++depth) { // по возрастанию, чтобы работало упорядочивание
+                values[depth] = engine.searchDepth(depth);
+            }
+            ++positions;
+            int stage = PatternEvaluator::getStage(board.getBitboard(player), board.getBitboard(!player));
+            for (int depth = PROBCUT_MIN_DEPTH; depth <= maxDepth; ++depth) {
+                for (int check = 0; check < PROBCUT_CHECKS; ++check) {
+                    int shallow = ProbCut::getShallowDepth(depth, check);
+                    if (shallow == 0 || abs(values[depth]) >= MAX_VALUE / 2 || abs(values[shallow]) >= MAX_VALUE / 2) {
+                        continue; // проверки нет или исход уже известен, для регрессии бесполезно
+                    }
+                    addSample(regressions[getRegressionIndex(stage, depth, check)], values[shallow], values[depth]);
+                }
+            }
+        }
+        std::cerr << "\r" << games << " games, " << positions << " positions" << std::flush;
+    }
+    std::cerr << std::endl;
+
+    ProbCut probCut;
+    for (int stage = 0; stage < PATTERN_STAGES; ++stage) {
+        for (int depth = PROBCUT_MIN_DEPTH; depth <= maxDepth; ++depth) {
+            for (int check = 0; check < PROBCUT_CHECKS; ++check) {
+                const Regression& regression = regressions[getRegressionIndex(stage, depth, check)];
+                ProbCutParams params = { ProbCut::getShallowDepth(depth, check), 1.0f, 0.0f, 0.0f };
+                if (params.shallow == 0 || !fit(regression, params)) {
+                    continue;
+                }
+                probCut.setParams(stage, depth, check, params);
+                std::cerr << "stage " << stage << " depth " << depth << "/" << params.shallow << ": a " << params.a
+                    << " b " << params.b << " sigma " << params.sigma << " (" << regression.count << ")" << std::endl;
+            }
+        }
+    }
+    if (!probCut.save(argv[2])) {
+        std::cerr << "can't write " << argv[2] << std::endl;
+        return 1;
+    }
+    return 0;
+}
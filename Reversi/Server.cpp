@@ -0,0 +1,277 @@
+#include <sstream>
+#include "Server.h"
+
+
+namespace reversi
+{
+    EngineServer::EngineServer(const OpeningBook* book_, const PatternEvaluator* patterns_, const ProbCut* probCut_) :
+        book(book_),
+        patterns(patterns_),
+        probCut(probCut_),
+        isReductionEnabled(false),
+        telemetry(nullptr),
+        threads(1),
+        isStopping(false),
+        output(nullptr)
+    {
+    }
+
+    EngineServer::~EngineServer()
+    {
+    }
+
+    void EngineServer::setThreads(int threads_)
+    {
+        threads = threads_ > 0 ? threads_ : 1;
+    }
+
+    void EngineServer::setLateMoveReductions(bool isEnabled)
+    {
+        isReductionEnabled = isEnabled;
+    }
+
+    void EngineServer::setTelemetry(TelemetryLog* telemetry_)
+    {
+        telemetry = telemetry_;
+    }
+
+    /*
+    Читаем команды до конца входа, затем дожидаемся всех начатых поисков
+    */
+    void EngineServer::run(std::istream& input, std::ostream& output_)
+    {
+        output = &output_;
+        isStopping = false;
+        for (int x = 0; x < threads; ++x) {
+            Worker* worker = new Worker;
+            worker->stopFlag = false;
+            worker->isBusy = false;
+            workers.push_back(worker);
+        }
+        for (size_t x = 0; x < workers.size(); ++x) {
+            workers[x]->thread = std::thread(&EngineServer::work, this, workers[x]);
+        }
+        std::thread watcher(&EngineServer::watch, this);
+
+        std::string line;
+        while (std::getline(input, line)) {
+            std::istringstream stream(line);
+            std::string id;
+            if (!(stream >> id)) {
+                continue;
+            }
+            std::string command;
+            std::getline(stream >> std::ws, command);
+            std::lock_guard<std::mutex> lock(mutex);
+            handle(id, command);
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            idleCondition.wait(lock, [this]() {
+                for (std::map<std::string, Session>::const_iterator x = sessions.begin(); x != sessions.end(); ++x) {
+                    if (x->second.isBusy) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+            isStopping = true;
+        }
+        jobCondition.notify_all();
+        watchCondition.notify_all();
+        for (size_t x = 0; x < workers.size(); ++x) {
+            workers[x]->thread.join();
+            delete workers[x];
+        }
+        workers.clear();
+        watcher.join();
+        output->flush();
+    }
+
+    /*
+    Команда сессии. Пока ищется ход, команды сессии откладываются и выполняются после ответа
+    */
+    void EngineServer::handle(const std::string& id, const std::string& command)
+    {
+        std::istringstream stream(command);
+        std::string name;
+        stream >> name;
+        if (name == "init") { // новая партия с начальной позиции
+            std::map<std::string, Session>::iterator busy = sessions.find(id);
+            if (busy != sessions.end() && busy->second.isBusy) {
+                busy->second.pending.push_back(command); // начнём заново, когда поиск вернётся
+                return;
+            }
+            Session session;
+            session.budgetMs = TIME_LIMIT * 1000;
+            session.isBusy = false;
+            sessions[id] = session;
+            return;
+        }
+        std::map<std::string, Session>::iterator found = sessions.find(id);
+        if (found == sessions.end()) {
+            return;
+        }
+        Session& session = found->second;
+        if (name == "bad" || name == "lose" || name == "win" || name == "draw" || name == "end") {
+            if (session.isBusy) {
+                session.pending.push_back(command); // закроем, когда поиск вернётся
+            }
+            else {
+                sessions.erase(found);
+            }
+            return;
+        }
+        if (session.isBusy) {
+            session.pending.push_back(command);
+            return;
+        }
+        if (name == "time") {
+            int budgetMs;
+            if (stream >> budgetMs && budgetMs > 0) {
+                session.budgetMs = budgetMs;
+            }
+        }
+        else if (name == "move") {
+            char y;
+            int x;
+            if (stream >> y >> x) {
+                session.board.setCeil(8 * (x - 1) + (y - 'a'));
+            }
+        }
+        else if (name == "turn") {
+            Job job;
+            job.id = id;
+            job.board = session.board;
+            job.deadline = Clock::now() + std::chrono::milliseconds(session.budgetMs - SERVER_MARGIN_MS);
+            session.isBusy = true;
+            jobs.push(job);
+            jobCondition.notify_one();
+        }
+    }
+
+    /*
+    Поток пула: берёт задачу с ближайшим сроком. Если до срока почти ничего не осталось
+    (сервер перегружен), отвечает коротким поиском на фиксированную глубину, иначе
+    ищет, пока сторож не выставит флаг остановки
+    */
+    void EngineServer::work(Worker* worker)
+    {
+        Reversi engine;
+        engine.setTimeLimit(0); // останавливает сторож
+        engine.setStopFlag(&worker->stopFlag);
+        engine.setOpeningBook(book);
+        if (patterns != nullptr) {
+            engine.setPatternEvaluator(patterns);
+        }
+        engine.setProbCut(probCut);
+        engine.setLateMoveReductions(isReductionEnabled);
+        engine.setTelemetry(telemetry, "server");
+
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobCondition.wait(lock, [this]() { return !jobs.empty() || isStopping; });
+                if (jobs.empty()) {
+                    return;
+                }
+                job = jobs.top();
+                jobs.pop();
+                worker->stopFlag = false;
+                worker->isBusy = true;
+                worker->deadline = job.deadline;
+            }
+            watchCondition.notify_one();
+
+            engine.setBoard(job.board);
+            int move = -1;
+            if (job.board.isGame()) {
+                if (Clock::now() + std::chrono::milliseconds(SERVER_MIN_SEARCH_MS) >= job.deadline) {
+                    engine.setStopFlag(nullptr); // мелкий поиск доводим до конца, иначе ход будет недосчитан
+                    engine.searchDepth(SERVER_QUICK_DEPTH);
+                    engine.setStopFlag(&worker->stopFlag);
+                    move = engine.getBestMove();
+                }
+                else {
+                    move = engine.callAIMove();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                worker->isBusy = false;
+            }
+            finish(job.id, move);
+        }
+    }
+
+    /*
+    Сторож сроков: останавливает поиски, у которых вышло время
+    */
+    void EngineServer::watch()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!isStopping) {
+            Clock::time_point now = Clock::now();
+            Clock::time_point next = now + std::chrono::seconds(1);
+            for (size_t x = 0; x < workers.size(); ++x) {
+                if (!workers[x]->isBusy) {
+                    continue;
+                }
+                if (workers[x]->deadline <= now) {
+                    workers[x]->stopFlag = true;
+                }
+                else if (workers[x]->deadline < next) {
+                    next = workers[x]->deadline;
+                }
+            }
+            watchCondition.wait_until(lock, next);
+        }
+    }
+
+    /*
+    Первый законный ход ходящего или -1, если партия окончена
+    */
+    int EngineServer::getFirstMove(Board& board)
+    {
+        if (!board.isGame()) {
+            return -1;
+        }
+        bool player = board.getPlayerColor();
+        Bitboard moves = getMoves(board.getBitboard(player), board.getBitboard(!player));
+        return moves != 0 ? getFirstIndex(moves) : -1;
+    }
+
+    /*
+    Ответ сессии и выполнение отложенных команд
+    */
+    void EngineServer::finish(const std::string& id, int move)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<std::string, Session>::iterator found = sessions.find(id);
+        if (found != sessions.end()) {
+            Session& session = found->second;
+            session.isBusy = false;
+            if (move < 0 || !session.board.setCeil(move)) { // сессия ждёт хода - отвечаем любым законным
+                move = getFirstMove(session.board);
+                if (move >= 0) {
+                    session.board.setCeil(move);
+                }
+            }
+            if (move >= 0) {
+                *output << id << " move " << (char)(move % 8 + 'a') << " " << move / 8 + 1 << std::endl;
+            }
+            else {
+                *output << id << " pass" << std::endl;
+            }
+            std::deque<std::string> pending;
+            pending.swap(session.pending);
+            for (size_t x = 0; x < pending.size(); ++x) {
+                handle(id, pending[x]); // может снова занять сессию, тогда остаток отложится заново
+            }
+        }
+        idleCondition.notify_all();
+    }
+}
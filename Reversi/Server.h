@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Game.h"
+
+namespace reversi
+{
+    const int SERVER_QUICK_DEPTH = 2; // ответ без поиска по времени, если очередь съела почти весь бюджет
+    const int SERVER_MIN_SEARCH_MS = 30; // меньше этого на поиск не запускаем
+    const int SERVER_MARGIN_MS = 20; // запас на вывод ответа
+
+    /*
+    Сервер многих партий в одном процессе. Команды протокола те же, что у одиночной игры,
+    но каждая строка начинается с номера сессии:
+      <id> init <color>, <id> turn, <id> move <столбец> <строка>, <id> time <мс на ход>,
+      <id> bad|lose|win|draw|end - партия закончена
+    Ответ на turn: "<id> move <столбец> <строка>" (или "<id> pass").
+    Поиски всех сессий идут на общем пуле потоков в порядке ближайшего срока ответа;
+    у каждого потока свой движок, книга, шаблоны и параметры ProbCut общие
+    */
+    class EngineServer
+    {
+    public:
+        EngineServer(const OpeningBook* book_, const PatternEvaluator* patterns_, const ProbCut* probCut_);
+        ~EngineServer();
+
+        void setThreads(int threads_);
+        void setLateMoveReductions(bool isEnabled);
+        void setTelemetry(TelemetryLog* telemetry_);
+
+        void run(std::istream& input, std::ostream& output);
+
+    private:
+        EngineServer(const EngineServer&);
+        EngineServer& operator=(const EngineServer&);
+
+        typedef std::chrono::steady_clock Clock;
+
+        struct Session
+        {
+            Board board;
+            int budgetMs; // время на ход
+            bool isBusy; // ход ищется, команды пока откладываем
+            std::deque<std::string> pending;
+        };
+
+        struct Job
+        {
+            std::string id;
+            Board board;
+            Clock::time_point deadline;
+
+            bool operator<(const Job& job) const { // для очереди с приоритетом: раньше срок - выше
+                return deadline > job.deadline;
+            }
+        };
+
+        struct Worker
+        {
+            std::thread thread;
+            std::atomic<bool> stopFlag;
+            bool isBusy; // под mutex
+            Clock::time_point deadline; // под mutex
+        };
+
+        void handle(const std::string& id, const std::string& command); // под mutex
+        void work(Worker* worker);
+        void watch();
+        void finish(const std::string& id, int move);
+        static int getFirstMove(Board& board);
+
+        const OpeningBook* book;
+        const PatternEvaluator* patterns;
+        const ProbCut* probCut;
+        bool isReductionEnabled;
+        TelemetryLog* telemetry;
+        int threads;
+
+        std::mutex mutex;
+        std::condition_variable jobCondition; // появилась задача или пора заканчивать
+        std::condition_variable watchCondition; // поток взял задачу - у сторожа новый срок
+        std::condition_variable idleCondition; // сессия закончила поиск
+        std::map<std::string, Session> sessions; // под mutex
+        std::priority_queue<Job> jobs; // под mutex
+        std::vector<Worker*> workers;
+        bool isStopping; // под mutex
+        std::ostream* output; // под mutex
+    };
+}
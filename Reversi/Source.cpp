@@ -1,14 +1,141 @@
-﻿#include <string>
+﻿#include <cstdlib>
+#include <string>
 #include <iostream>
+#include <fstream>
+#include <thread>
 #include <vector>
+#include "Batch.h"
 #include "Game.h"
+#include "Ponder.h"
+#include "Server.h"
 
 using namespace reversi;
 
 
-int main()
+int main(int argc, char** argv)
 {
+    std::string bookPath = "book.bin"; // дебютная книга, если есть
+    std::string patternsPath = "patterns.bin"; // веса шаблонов, если есть
+    std::string probCutPath; // параметры Multi-ProbCut, пусто - выключен (выигрыш в матчах не показан)
+    bool isPonderEnabled = true; // думать во время хода соперника
+    bool isReductionEnabled = false; // сокращение глубины для поздних ходов, пока без выигрыша в матчах
+    std::string telemetryPath; // журнал поиска в JSON, "-" - в stderr, пусто - выключен
+    std::string batchPath; // пакетный анализ позиций из файла, "-" - из stdin
+    bool isServer = false; // много партий в одном процессе, команды с номером сессии
+    bool isBinary = false;
+    int depth = -1; // не задана: по умолчанию как в игре, а с --nodes - без ограничения
+    long long nodeLimit = 0;
+    int endgameEmpties = ENDGAME_EMPTIES;
+    int threads = (int)std::thread::hardware_concurrency();
+    for (int x = 1; x < argc; ++x) {
+        std::string arg = argv[x];
+        if (arg == "--book" && x + 1 < argc) {
+            bookPath = argv[++x];
+        }
+        else if (arg == "--patterns" && x + 1 < argc) {
+            patternsPath = argv[++x];
+        }
+        else if (arg == "--probcut" && x + 1 < argc) {
+            probCutPath = argv[++x];
+        }
+        else if (arg == "--telemetry" && x + 1 < argc) {
+            telemetryPath = argv[++x];
+        }
+        else if (arg == "--lmr") {
+            isReductionEnabled = true;
+        }
+        else if (arg == "--no-ponder") {
+            isPonderEnabled = false;
+        }
+        else if (arg == "--batch" && x + 1 < argc) {
+            batchPath = argv[++x];
+        }
+        else if (arg == "--server") {
+            isServer = true;
+        }
+        else if (arg == "--binary") {
+            isBinary = true;
+        }
+        else if (arg == "--depth" && x + 1 < argc) {
+            depth = atoi(argv[++x]);
+        }
+        else if (arg == "--nodes" && x + 1 < argc) {
+            nodeLimit = atoll(argv[++x]);
+        }
+        else if (arg == "--endgame" && x + 1 < argc) {
+            endgameEmpties = atoi(argv[++x]);
+        }
+        else if (arg == "--threads" && x + 1 < argc) {
+            threads = atoi(argv[++x]);
+        }
+    }
+    OpeningBook book;
+    book.load(bookPath);
+    PatternEvaluator patterns;
+    patterns.load(patternsPath);
+    ProbCut probCut;
+    if (!probCutPath.empty()) {
+        probCut.load(probCutPath);
+    }
+    const ProbCut* selectivity = probCut.isLoaded() ? &probCut : nullptr;
+    TelemetryLog telemetry;
+    if (!telemetryPath.empty() && !telemetry.open(telemetryPath)) {
+        std::cerr << "can't open " << telemetryPath << std::endl;
+    }
+    TelemetryLog* log = telemetry.isOpen() ? &telemetry : nullptr;
+
+    if (!batchPath.empty()) {
+        if (depth < 0) {
+            depth = nodeLimit > 0 ? 0 : MAX_DEPTH - 1;
+        }
+        if (depth == 0 && nodeLimit <= 0) {
+            std::cerr << "batch mode needs --depth or --nodes" << std::endl;
+            return 1;
+        }
+        BatchAnalyzer analyzer(patterns.isLoaded() ? &patterns : nullptr);
+        analyzer.setThreads(threads);
+        analyzer.setDepth(depth);
+        analyzer.setNodeLimit(nodeLimit);
+        analyzer.setEndgameEmpties(endgameEmpties);
+        analyzer.setProbCut(selectivity);
+        analyzer.setLateMoveReductions(isReductionEnabled);
+        analyzer.setTelemetry(log);
+        std::ios::sync_with_stdio(false);
+        if (batchPath == "-") {
+            analyzer.run(std::cin, isBinary, std::cout);
+        }
+        else {
+            std::ifstream input(batchPath.c_str(), isBinary ? std::ios::binary : std::ios::in);
+            if (!input) {
+                std::cerr << "can't open " << batchPath << std::endl;
+                return 1;
+            }
+            analyzer.run(input, isBinary, std::cout);
+        }
+        return 0;
+    }
+
+    if (isServer) {
+        EngineServer server(&book, patterns.isLoaded() ? &patterns : nullptr, selectivity);
+        server.setThreads(threads);
+        server.setLateMoveReductions(isReductionEnabled);
+        server.setTelemetry(log);
+        server.run(std::cin, std::cout);
+        return 0;
+    }
+
     Reversi reversi;
+    reversi.setOpeningBook(&book);
+    if (patterns.isLoaded()) {
+        reversi.setPatternEvaluator(&patterns);
+    }
+    reversi.setProbCut(selectivity);
+    reversi.setLateMoveReductions(isReductionEnabled);
+    reversi.setTelemetry(log, "main");
+    Ponderer ponderer(&book, patterns.isLoaded() ? &patterns : nullptr, selectivity);
+    ponderer.setLateMoveReductions(isReductionEnabled);
+    ponderer.setTelemetry(log);
+
     std::string str;
     while (std::cin >> str) {
         if (str == "init") { // инициализация
@@ -16,7 +143,14 @@ int main()
             std::cin >> color;
         }
         if (str == "turn") { // пора сделать ход
-            int move = reversi.callAIMove();
+            bool ownColor = reversi.getBoard().getPlayerColor();
+            int move = ponderer.takeMove(TIME_LIMIT); // ход, найденный во время обдумывания
+            if (move < 0 || !reversi.setCeil(move)) {
+                move = reversi.callAIMove();
+            }
+            if (isPonderEnabled && reversi.isGame()) {
+                ponderer.start(reversi.getBoard(), ownColor);
+            }
             int x = (move / 8) + 1;
             char y = (char)(move % 8) + 'a';
             std::cout << "move " << y << " " << x << std::endl;
@@ -27,6 +161,7 @@ int main()
             std::cin >> y >> x;
             --x;
             int index = 8 * x + (y - 'a');
+            ponderer.onOpponentMove(index); // если ход не угадан, обдумывание прерывается
             reversi.setCeil(index);
         }
         if (str == "bad" || str == "lose" || str == "win" || str == "draw") {
@@ -0,0 +1,59 @@
+#include "Stability.h"
+
+
+namespace reversi
+{
+    namespace
+    {
+        const Bitboard EDGE_FILES = ~(NOT_A_FILE & NOT_H_FILE); // столбцы a и h
+        const Bitboard EDGE_ROWS = 0xff000000000000ffULL; // строки 1 и 8
+        const Bitboard BORDER = EDGE_FILES | EDGE_ROWS; // все крайние клетки
+
+        // пары противоположных направлений для каждой из 4-х осей
+        const int AXES[4][2] = { { 2, 6 }, { 0, 4 }, { 3, 7 }, { 1, 5 } };
+
+        // клетки, у которых вдоль оси есть край доски хотя бы с одной стороны
+        const Bitboard AXIS_EDGES[4] = { EDGE_FILES, EDGE_ROWS, BORDER, BORDER };
+
+        /*
+        Клетки, вся линия через которые вдоль оси axis заполнена.
+        Распространяем пустые клетки вдоль оси: всё, до чего они дотянулись, не заполнено
+        */
+        Bitboard getFullLines(Bitboard occupied, int axis) {
+            Bitboard empty = ~occupied;
+            for (int x = 0; x < 7; ++x) {
+                empty |= shift(empty, AXES[axis][0]) | shift(empty, AXES[axis][1]);
+            }
+            return ~empty;
+        }
+    }
+
+    /*
+    Итерация до неподвижной точки: на каждом шаге фишка стабильна, если
+    по всем осям она защищена заполненной линией, краем или уже стабильным соседом своего цвета
+    */
+    Bitboard getStableDiscsOf(Bitboard own, Bitboard opponent) {
+        Bitboard occupied = own | opponent;
+        Bitboard protectedByAxis[4];
+        for (int axis = 0; axis < 4; ++axis) {
+            protectedByAxis[axis] = getFullLines(occupied, axis) | AXIS_EDGES[axis];
+        }
+
+        Bitboard stable = 0;
+        while (true) {
+            Bitboard newStable = own;
+            for (int axis = 0; axis < 4; ++axis) {
+                newStable &= protectedByAxis[axis] |
+                    shift(stable, AXES[axis][0]) | shift(stable, AXES[axis][1]);
+            }
+            if (newStable == stable) {
+                return stable;
+            }
+            stable = newStable;
+        }
+    }
+
+    Bitboard getStableDiscs(Bitboard white, Bitboard black) {
+        return getStableDiscsOf(white, black) | getStableDiscsOf(black, white);
+    }
+}
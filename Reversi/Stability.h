@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Bitboard.h"
+
+namespace reversi
+{
+    /*
+    Множество стабильных фишек (тех, что уже никогда не будут перевёрнуты) обоих цветов.
+    Фишка стабильна, если по каждой из 4-х осей либо линия через неё целиком заполнена,
+    либо с одной из сторон край доски или стабильная фишка того же цвета.
+    Считается от углов и заполненных линий до неподвижной точки.
+    */
+    Bitboard getStableDiscs(Bitboard white, Bitboard black);
+
+    /*
+    Стабильные фишки только одного цвета
+    */
+    Bitboard getStableDiscsOf(Bitboard own, Bitboard opponent);
+}
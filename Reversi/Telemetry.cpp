@@ -0,0 +1,53 @@
+#include "Telemetry.h"
+
+
+namespace reversi
+{
+    TelemetryLog::TelemetryLog() :
+        file(nullptr),
+        isOwned(false)
+    {
+    }
+
+    TelemetryLog::~TelemetryLog()
+    {
+        close();
+    }
+
+    bool TelemetryLog::open(const std::string& path)
+    {
+        close();
+        if (path == "-") {
+            file = stderr;
+            return true;
+        }
+        file = fopen(path.c_str(), "a");
+        isOwned = file != nullptr;
+        return file != nullptr;
+    }
+
+    void TelemetryLog::close()
+    {
+        if (isOwned) {
+            fclose(file);
+        }
+        file = nullptr;
+        isOwned = false;
+    }
+
+    bool TelemetryLog::isOpen() const
+    {
+        return file != nullptr;
+    }
+
+    void TelemetryLog::write(const char* line)
+    {
+        if (file == nullptr) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        fputs(line, file);
+        fputc('\n', file);
+        fflush(file); // журнал читают, пока движок работает
+    }
+}
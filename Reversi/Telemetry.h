@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+namespace reversi
+{
+    /*
+    Счётчики одной итерации поиска. Считаются всегда (это несколько сложений на узел),
+    а время и запись в журнал - только если журнал подключён
+    */
+    struct SearchCounters
+    {
+        long long leaves; // листья: конец партии, предел глубины, известный исход
+        long long evaluations; // вызовы оценочной функции
+        long long interiorNodes; // узлы, в которых перебирались ходы
+        long long betaCutoffs;
+        long long firstMoveCutoffs; // отсечения на первом же ходе - мера качества упорядочивания
+        long long probCutCuts;
+        long long reductionResearches; // сокращённый поиск оказался лучше alpha и повторён полностью
+    };
+
+    /*
+    Журнал поиска: по JSON-объекту в строке, в файл или в stderr ("-").
+    Пишут в него движки из разных потоков, строки не перемешиваются
+    */
+    class TelemetryLog
+    {
+    public:
+        TelemetryLog();
+        ~TelemetryLog();
+
+        bool open(const std::string& path);
+        void close();
+        bool isOpen() const;
+
+        void write(const char* line);
+
+    private:
+        TelemetryLog(const TelemetryLog&);
+        TelemetryLog& operator=(const TelemetryLog&);
+
+        FILE* file;
+        bool isOwned; // файл открыт нами, а не stderr
+        std::mutex mutex;
+    };
+}
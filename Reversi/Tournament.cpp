@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Game.h"
+#include "GameRecord.h"
+
+using namespace reversi;
+
+/*
+Матч двух движков самоигрой, по партии на поток.
+  Tournament --a <config> --b <config> [--openings <file> | --random-plies N] [--seed N] [--games N]
+             [--threads N] [--log <file>] [--sprt <elo0> <elo1>]
+config - пары ключ=значение через запятую: depth, time, endgame, patterns, mobility, stable, table,
+probcut (файл параметров Multi-ProbCut), lmr (1 - сокращение поздних ходов, по умолчанию выключено).
+Каждый дебют из файла (по строке ходов, см. GameRecord.h) играется дважды со сменой цвета.
+Без файла дебюты - случайные первые ходы (по умолчанию RANDOM_OPENING_PLIES), свой на каждую
+пару партий: движки детерминированы, и с одной начальной позиции все пары повторяли бы одна другую.
+У каждой партии свои экземпляры Reversi, общие между потоками только таблицы шаблонов
+*/
+
+namespace
+{
+    const int RANDOM_OPENING_PLIES = 8;
+
+    struct EngineConfig
+    {
+        std::string name;
+        int depth; // 0 - до MAX_DEPTH
+        int time; // секунд на ход, 0 - без ограничения
+        int endgameEmpties;
+        EvalWeights weights;
+        std::string patternsPath;
+        PatternEvaluator patterns;
+        ProbCut probCut;
+        bool isReductionEnabled;
+
+        std::atomic<long long> depthSum; // законченные итерации по ходам до эндшпиля
+        std::atomic<long long> searchCount;
+    };
+
+    bool parseConfig(const std::string& text, EngineConfig& config) {
+        config.name = text;
+        config.depth = 0;
+        config.time = TIME_LIMIT;
+        config.endgameEmpties = ENDGAME_EMPTIES;
+        config.weights = DEFAULT_WEIGHTS;
+        config.isReductionEnabled = false;
+        config.depthSum = 0;
+        config.searchCount = 0;
+
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            size_t separator = item.find('=');
+            if (separator == std::string::npos) {
+                return false;
+            }
+            std::string key = item.substr(0, separator);
+            std::string value = item.substr(separator + 1);
+            if (key == "patterns") {
+                config.patternsPath = value;
+                if (!config.patterns.load(value)) {
+                    std::cerr << "can't load patterns " << value << std::endl;
+                    return false;
+                }
+                continue;
+            }
+            if (key == "probcut") {
+                if (!config.probCut.load(value)) {
+                    std::cerr << "can't load probcut " << value << std::endl;
+                    return false;
+                }
+                continue;
+            }
+            int number = atoi(value.c_str());
+            if (key == "depth") {
+                config.depth = number;
+            }
+            else if (key == "time") {
+                config.time = number;
+            }
+            else if (key == "endgame") {
+                config.endgameEmpties = number;
+            }
+            else if (key == "mobility") {
+                config.weights.mobility = number;
+            }
+            else if (key == "stable") {
+                config.weights.stable = number;
+            }
+            else if (key == "table") {
+                config.weights.table = number;
+            }
+            else if (key == "lmr") {
+                config.isReductionEnabled = number != 0;
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void configure(Reversi& engine, const EngineConfig& config) {
+        engine.setTimeLimit(config.time);
+        if (config.depth > 0) {
+            engine.setMaxDepth(config.depth + 1); // итеративное углубление идёт до maxDepth не включительно
+        }
+        engine.setEndgameEmpties(config.endgameEmpties);
+        engine.setEvalWeights(config.weights);
+        if (config.patterns.isLoaded()) {
+            engine.setPatternEvaluator(&config.patterns);
+        }
+        if (config.probCut.isLoaded()) {
+            engine.setProbCut(&config.probCut);
+        }
+        engine.setLateMoveReductions(config.isReductionEnabled);
+    }
+
+    struct GameTask
+    {
+        int opening;
+        bool isFirstBlack; // первый движок играет чёрными
+    };
+
+    struct MatchStats
+    {
+        std::atomic<int> wins; // с точки зрения первого движка
+        std::atomic<int> draws;
+        std::atomic<int> losses;
+        std::atomic<bool> isStopped; // SPRT принял решение
+    };
+
+    /*
+    Партия от дебютной позиции до конца. Возвращает разницу фишек с точки зрения чёрных
+    */
+    int playGame(const std::vector<int>& opening, EngineConfig& blackConfig,
+        EngineConfig& whiteConfig, std::vector<int>& moves) {
+        Board board;
+        moves.clear();
+        for (size_t x = 0; x < opening.size() && board.setCeil(opening[x]); ++x) {
+            moves.push_back(opening[x]);
+        }
+
+        Reversi black(board);
+        Reversi white(board);
+        configure(black, blackConfig);
+        configure(white, whiteConfig);
+        while (board.isGame()) {
+            bool isBlack = board.getPlayerColor() == BLACK;
+            EngineConfig& config = isBlack ? blackConfig : whiteConfig;
+            int empties = 64 - popCount(board.getBitboard(BLACK) | board.getBitboard(WHITE));
+            int move = (isBlack ? black : white).callAIMove();
+            if (empties > config.endgameEmpties) { // до точного решателя - глубина обычного поиска
+                config.depthSum += (isBlack ? black : white).getSearchDepth();
+                ++config.searchCount;
+            }
+            (isBlack ? white : black).setCeil(move);
+            board.setCeil(move);
+            moves.push_back(move);
+        }
+        return popCount(board.getBitboard(BLACK)) - popCount(board.getBitboard(WHITE));
+    }
+
+    /*
+    Дебют из plies случайных ходов. Если партия за это время закончилась, пробуем ещё раз
+    */
+    std::vector<int> makeRandomOpening(std::mt19937& random, int plies) {
+        while (true) {
+            Board board;
+            std::vector<int> moves;
+            for (int x = 0; x < plies && board.isGame(); ++x) {
+                bool player = board.getPlayerColor();
+                Bitboard legal = getMoves(board.getBitboard(player), board.getBitboard(!player));
+                for (int skip = (int)(random() % popCount(legal)); skip > 0; --skip) {
+                    legal &= legal - 1;
+                }
+                moves.push_back(getFirstIndex(legal));
+                board.setCeil(moves.back());
+            }
+            if (board.isGame()) {
+                return moves;
+            }
+        }
+    }
+
+    /*
+    Оценка разницы в силе по набранным очкам и 95% доверительный интервал
+    */
+    double getElo(double score) {
+        if (score <= 0) {
+            return -1000;
+        }
+        if (score >= 1) {
+            return 1000;
+        }
+        return -400 * log10(1 / score - 1);
+    }
+
+    /*
+    Логарифм отношения правдоподобия для гипотез elo0 и elo1 (нормальное приближение)
+    */
+    double getLLR(int winsCount, int drawsCount, int lossesCount, double elo0, double elo1) {
+        // по половине псевдопартии на исход, чтобы дисперсия не обнулялась при разгромном счёте
+        double wins = winsCount + 0.5;
+        double draws = drawsCount + 0.5;
+        double losses = lossesCount + 0.5;
+        double games = wins + draws + losses;
+        double score = (wins + 0.5 * draws) / games;
+        double variance = (wins * (1 - score) * (1 - score) + draws * (0.5 - score) * (0.5 - score) +
+            losses * score * score) / games;
+        double score0 = 1 / (1 + pow(10, -elo0 / 400));
+        double score1 = 1 / (1 + pow(10, -elo1 / 400));
+        return (score1 - score0) * (2 * score - score0 - score1) * games / (2 * variance);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string configs[2];
+    std::string openingsPath;
+    std::string logPath;
+    int gamesCount = 100;
+    int randomPlies = RANDOM_OPENING_PLIES;
+    unsigned seed = 2017;
+    int threadsCount = (int)std::thread::hardware_concurrency();
+    bool isSprt = false;
+    double elo0 = 0;
+    double elo1 = 10;
+    for (int x = 1; x < argc; ++x) {
+        std::string arg = argv[x];
+        if (arg == "--a" && x + 1 < argc) {
+            configs[0] = argv[++x];
+        }
+        else if (arg == "--b" && x + 1 < argc) {
+            configs[1] = argv[++x];
+        }
+        else if (arg == "--openings" && x + 1 < argc) {
+            openingsPath = argv[++x];
+        }
+        else if (arg == "--random-plies" && x + 1 < argc) {
+            randomPlies = atoi(argv[++x]);
+        }
+        else if (arg == "--seed" && x + 1 < argc) {
+            seed = (unsigned)atoi(argv[++x]);
+        }
+        else if (arg == "--games" && x + 1 < argc) {
+            gamesCount = atoi(argv[++x]);
+        }
+        else if (arg == "--threads" && x + 1 < argc) {
+            threadsCount = atoi(argv[++x]);
+        }
+        else if (arg == "--log" && x + 1 < argc) {
+            logPath = argv[++x];
+        }
+        else if (arg == "--sprt" && x + 2 < argc) {
+            isSprt = true;
+            elo0 = atof(argv[++x]);
+            elo1 = atof(argv[++x]);
+        }
+        else {
+            std::cerr << "usage: Tournament --a <config> --b <config> [--openings <file> | --random-plies N]"
+                " [--seed N] [--games N] [--threads N] [--log <file>] [--sprt <elo0> <elo1>]" << std::endl;
+            return 1;
+        }
+    }
+
+    EngineConfig engines[2];
+    for (int x = 0; x < 2; ++x) {
+        if (!parseConfig(configs[x], engines[x])) {
+            std::cerr << "bad engine config \"" << configs[x] << "\"" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::vector<int> > openings;
+    if (!openingsPath.empty()) {
+        std::ifstream input(openingsPath.c_str());
+        std::string line;
+        while (std::getline(input, line)) {
+            openings.push_back(parseMoves(line));
+        }
+    }
+    if (openingsPath.empty()) {
+        if (randomPlies <= 0) {
+            std::cerr << "without --openings the games need random first moves (--random-plies > 0)" << std::endl;
+            return 1;
+        }
+        std::mt19937 random(seed);
+        for (int x = 0; x < (gamesCount + 1) / 2; ++x) {
+            openings.push_back(makeRandomOpening(random, randomPlies));
+        }
+    }
+    if (openings.empty()) {
+        std::cerr << "no openings in " << openingsPath << std::endl;
+        return 1;
+    }
+
+    std::vector<GameTask> tasks;
+    for (int x = 0; x < gamesCount; ++x) {
+        GameTask task = { (x / 2) % (int)openings.size(), x % 2 == 0 };
+        tasks.push_back(task);
+    }
+
+    std::ofstream log;
+    if (!logPath.empty()) {
+        log.open(logPath.c_str());
+    }
+    std::mutex outputMutex;
+
+    MatchStats stats;
+    stats.wins = 0;
+    stats.draws = 0;
+    stats.losses = 0;
+    stats.isStopped = false;
+    std::atomic<size_t> nextTask(0);
+    const double lowerBound = log10(0.05 / 0.95) / log10(exp(1.0)); // alpha = beta = 0.05
+    const double upperBound = -lowerBound;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int x = 0; x < std::max(threadsCount, 1); ++x) {
+        workers.push_back(std::thread([&]() {
+            std::vector<int> moves;
+            size_t index;
+            while (!stats.isStopped && (index = nextTask++) < tasks.size()) {
+                const GameTask& task = tasks[index];
+                EngineConfig& blackConfig = engines[task.isFirstBlack ? 0 : 1];
+                EngineConfig& whiteConfig = engines[task.isFirstBlack ? 1 : 0];
+                int blackResult = playGame(openings[task.opening], blackConfig, whiteConfig, moves);
+                int result = task.isFirstBlack ? blackResult : -blackResult;
+                if (result > 0) {
+                    ++stats.wins;
+                }
+                else if (result < 0) {
+                    ++stats.losses;
+                }
+                else {
+                    ++stats.draws;
+                }
+
+                std::lock_guard<std::mutex> lock(outputMutex);
+                if (log.is_open()) {
+                    for (size_t y = 0; y < moves.size(); ++y) {
+                        log << formatMove(moves[y]);
+                    }
+                    log << std::endl;
+                }
+                std::cerr << "game " << index + 1 << ": " << (result > 0 ? "win" : (result < 0 ? "loss" : "draw"))
+                    << " " << result << " (+" << stats.wins << " =" << stats.draws << " -" << stats.losses << ")"
+                    << std::endl;
+                if (isSprt) {
+                    double llr = getLLR(stats.wins, stats.draws, stats.losses, elo0, elo1);
+                    if (llr <= lowerBound || llr >= upperBound) {
+                        stats.isStopped = true;
+                    }
+                }
+            }
+        }));
+    }
+    for (size_t x = 0; x < workers.size(); ++x) {
+        workers[x].join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int wins = stats.wins;
+    int draws = stats.draws;
+    int losses = stats.losses;
+    int games = wins + draws + losses;
+    double score = games > 0 ? (wins + 0.5 * draws) / games : 0.5;
+    double deviation = 0;
+    if (games > 0) {
+        double variance = (wins * (1 - score) * (1 - score) + draws * (0.5 - score) * (0.5 - score) +
+            losses * score * score) / games;
+        deviation = sqrt(variance / games);
+    }
+
+    printf("%s vs %s\n", engines[0].name.c_str(), engines[1].name.c_str());
+    printf("games %d: +%d =%d -%d, score %.3f\n", games, wins, draws, losses, score);
+    for (int x = 0; x < 2; ++x) {
+        long long searches = engines[x].searchCount;
+        printf("%c: average depth %.2f over %lld moves\n", 'a' + x,
+            searches > 0 ? (double)engines[x].depthSum / searches : 0.0, searches);
+    }
+    printf("elo %.1f [%.1f, %.1f]\n", getElo(score), getElo(score - 1.96 * deviation), getElo(score + 1.96 * deviation));
+    if (isSprt) {
+        double llr = getLLR(wins, draws, losses, elo0, elo1);
+        printf("sprt elo0 %.1f elo1 %.1f: llr %.2f [%.2f, %.2f] %s\n", elo0, elo1, llr, lowerBound, upperBound,
+            llr >= upperBound ? "H1 accepted" : (llr <= lowerBound ? "H0 accepted" : "inconclusive"));
+    }
+    printf("%.1f s, %.3f games/s, %d threads\n", seconds, seconds > 0 ? games / seconds : 0.0, (int)workers.size());
+    return 0;
+}